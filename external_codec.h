@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <type_traits>
+
+/// Кодирование элементов для ExternalStorage.
+/// trivial == true - элементы хранятся как есть (блок читается и пишется одним fread/fwrite, без заголовков);
+/// иначе элементы кодируются друг за другом и могут иметь разную длину.
+/// Для своих типов достаточно специализировать ExternalCodec<T> по образцу ExternalCodec<std::string>
+template <class T>
+struct ExternalCodec
+{
+    static_assert(std::is_trivially_copyable<T>::value, "ExternalCodec must be specialized for non-trivially-copyable types");
+
+    static const bool trivial = true;
+
+    static size_t size(T const&)
+    {
+        return sizeof(T);
+    }
+
+    static char* encode(T const& val, char* out)
+    {
+        memcpy(out, &val, sizeof(T));
+        return out + sizeof(T);
+    }
+
+    static char const* decode(char const* in, T& val)
+    {
+        memcpy(&val, in, sizeof(T));
+        return in + sizeof(T);
+    }
+};
+
+/// Строка хранится как длина (uint32_t) и символы
+template <>
+struct ExternalCodec<std::string>
+{
+    static const bool trivial = false;
+
+    static size_t size(std::string const& val)
+    {
+        return sizeof(uint32_t) + val.size();
+    }
+
+    static char* encode(std::string const& val, char* out)
+    {
+        uint32_t len = val.size();
+        memcpy(out, &len, sizeof(len));
+        memcpy(out + sizeof(len), val.data(), len);
+        return out + sizeof(len) + len;
+    }
+
+    static char const* decode(char const* in, std::string& val)
+    {
+        uint32_t len;
+        memcpy(&len, in, sizeof(len));
+        val.assign(in + sizeof(len), len);
+        return in + sizeof(len) + len;
+    }
+};
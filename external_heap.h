@@ -1,8 +1,11 @@
+#pragma once
+
 #include <cassert>
 #include <iostream>
 #include <sstream>
 #include <iomanip>
 #include <algorithm>
+#include <iterator>
 
 #include "external_storage.h"
 
@@ -17,12 +20,26 @@ std::string toString(T const& val)
 struct NoElementsInHeapException {};
 struct TooLargeBlockException {};
 
+/// Для тривиальных типов в каждой вершине кучи (блоке) ровно elementsPerBlock элементов, кроме последней.
+/// Для остальных (см. ExternalCodec) вершины упаковываются по байтам, см. ExternalHeap<T, false>
+template <class T, bool = ExternalCodec<T>::trivial>
+class ExternalHeap;
+
 template <class T>
-class ExternalHeap
+class ExternalHeap<T, true>
 {
 public:
-    ExternalHeap(std::string const& storageFileName, int64_t elementsPerBlock)
-        : storage(storageFileName, elementsPerBlock, true)
+    /// subtreeHeight - см. ExternalStorage (расположение блоков в файле поддеревьями для локальности путей просеивания)
+    ExternalHeap(std::string const& storageFileName, int64_t elementsPerBlock, int64_t subtreeHeight = 1)
+        : storage(storageFileName, elementsPerBlock, true, subtreeHeight)
+        , elementsPerBlock(elementsPerBlock)
+        , N(0)
+    {
+    }
+
+    /// Куча в многоуровневом хранилище (см. StorageTier)
+    ExternalHeap(std::vector<StorageTier> const& storageTiers, int64_t elementsPerBlock, int64_t subtreeHeight = 1)
+        : storage(storageTiers, elementsPerBlock, true, subtreeHeight)
         , elementsPerBlock(elementsPerBlock)
         , N(0)
     {
@@ -110,6 +127,55 @@ public:
         insert(newBlock);
     }
 
+    /// Слияние с другой кучей за O((N1 + N2) / B) операций ввода-вывода: блоки other последовательно
+    /// дописываются в конец, после чего дерево блоков перестраивается снизу вверх. other становится пустой
+    void meld(ExternalHeap&& other)
+    {
+        if (&other == this || other.N == 0)
+            return;
+
+        int64_t blockNum = N / elementsPerBlock;
+        std::vector<T> carry;
+        if ((N % elementsPerBlock) > 0)
+        {
+            // Последняя недозаполненная вершина кучи будет перезаписана
+            carry = storage.readBlock(blockNum);
+            carry.resize(N % elementsPerBlock);
+        }
+
+        int64_t otherBCount = other.blocksCount();
+        for (int64_t i = 0; i < otherBCount; ++i)
+        {
+            std::vector<T> block = other.storage.readBlock(i);
+            if (i == other.N / other.elementsPerBlock)
+                block.resize(other.N % other.elementsPerBlock);
+            carry.insert(carry.end(), block.begin(), block.end());
+
+            while (carry.size() >= elementsPerBlock)
+            {
+                std::vector<T> next(carry.begin(), carry.begin() + elementsPerBlock);
+                carry.erase(carry.begin(), carry.begin() + elementsPerBlock);
+                std::sort(next.begin(), next.end(), std::greater<T>());
+                storage.writeBlock(blockNum++, next);
+            }
+        }
+        if (!carry.empty())
+        {
+            std::sort(carry.begin(), carry.end(), std::greater<T>());
+            storage.writeBlock(blockNum, carry);
+        }
+
+        N += other.N;
+        other.N = 0;
+
+        // Построение кучи снизу вверх: суммарная длина всех просеиваний - O(количества блоков)
+        for (int64_t i = blocksCount() / 2 - 1; i >= 0; --i)
+        {
+            std::vector<T> block = storage.readBlock(i);
+            siftDown(i, block);
+        }
+    }
+
     /// Пустая ли куча
     bool empty() const
     {
@@ -262,6 +328,18 @@ public:
         storage.printStats();
     }
 
+    /// Суммарное количество чтений и записей блоков
+    int64_t storageIOCount() const
+    {
+        return storage.ioCount();
+    }
+
+    /// Количество дальних переходов по файлу хранилища (см. ExternalStorage::farSeeksCount)
+    int64_t storageSeeksCount() const
+    {
+        return storage.farSeeksCount();
+    }
+
 private:
     int64_t blocksCount() const
     {
@@ -403,3 +481,559 @@ private:
     int64_t elementsPerBlock;
     int64_t N;
 };
+
+/// Куча для типов переменной длины: в вершину (слот хранилища) кладётся столько элементов, сколько помещается
+/// в bytesPerBlock байт (по ExternalCodec<T>::size), а не фиксированное количество. Новые вершины заполняются
+/// до бюджета; при просеивании элементы двух-трёх вершин делятся заново, и изредка вершина в бюджет
+/// не укладывается - тогда её хвост уходит в файл переполнения (лишнее чтение, но не ошибка).
+/// Элемент больше бюджета занимает вершину один
+template <class T>
+class ExternalHeap<T, false>
+{
+public:
+    /// bytesPerBlock - размер вершины в файле в байтах (см. ExternalStorage), subtreeHeight - см. ExternalStorage
+    ExternalHeap(std::string const& storageFileName, int64_t bytesPerBlock, int64_t subtreeHeight = 1)
+        : storage(storageFileName, 0, true, subtreeHeight, bytesPerBlock)
+        , budget(storage.slotCapacity())
+        , N(0)
+        , nodesCount(0)
+        , lastCount(-1)
+        , lastWeight(0)
+        , lastTruncated(false)
+    {
+    }
+
+    /// Куча в многоуровневом хранилище (см. StorageTier)
+    ExternalHeap(std::vector<StorageTier> const& storageTiers, int64_t bytesPerBlock, int64_t subtreeHeight = 1)
+        : storage(storageTiers, 0, true, subtreeHeight, bytesPerBlock)
+        , budget(storage.slotCapacity())
+        , N(0)
+        , nodesCount(0)
+        , lastCount(-1)
+        , lastWeight(0)
+        , lastTruncated(false)
+    {
+    }
+
+    ~ExternalHeap()
+    {
+    }
+
+    /// Добавление элемента (эффективнее добавлять блок элементов, если есть возможность)
+    void insert(T const& element)
+    {
+        int64_t w = ExternalCodec<T>::size(element);
+        ++N;
+
+        if (nodesCount > 0 && (lastCount < 0 || lastTruncated || lastWeight + w <= budget))
+        {
+            std::vector<T> last = readLast();
+            if (lastWeight + w <= budget)
+            {
+                // Элемент помещается в последнюю вершину кучи
+                bool siftupNeeded = last[0] < element;
+                last.insert(std::lower_bound(last.begin(), last.end(), element, std::greater<T>()), element);
+                if (siftupNeeded)
+                    siftUp(nodesCount - 1, last);
+                else
+                    writeNode(nodesCount - 1, last);
+                return;
+            }
+            if (lastTruncated)
+                writeNode(nodesCount - 1, last);  // Последняя вершина перестаёт быть последней: отрезаем устаревший хвост
+        }
+
+        // Создаём новую вершину кучи
+        appendNode(std::vector<T>(1, element));
+    }
+
+    /// Добавление блока элементов (если элементов больше одного, их коды должны поместиться в одну вершину)
+    void insert(std::vector<T>& block)
+    {
+        if (block.empty())
+            return;
+        if (block.size() > 1 && weightOf(block.begin(), block.end()) > budget)
+            throw TooLargeBlockException();
+
+        N += block.size();
+        std::sort(block.begin(), block.end(), std::greater<T>());
+
+        if (nodesCount > 0)
+        {
+            // Дополняем последнюю вершину кучи наименьшими элементами блока, сколько поместится
+            std::vector<T> last = readLast();
+            int64_t w = lastWeight;
+            size_t taken = 0;
+            while (taken < block.size() && w + int64_t(ExternalCodec<T>::size(block[block.size() - 1 - taken])) <= budget)
+                w += ExternalCodec<T>::size(block[block.size() - 1 - taken++]);
+
+            if (taken > 0 || lastTruncated)
+            {
+                std::vector<T> merged;
+                std::merge(last.begin(), last.end(), block.end() - taken, block.end(), std::back_inserter(merged), std::greater<T>());
+                block.resize(block.size() - taken);
+                if (taken > 0 && merged[0] > last[0])
+                    siftUp(nodesCount - 1, merged);
+                else
+                    writeNode(nodesCount - 1, merged);
+            }
+            if (block.empty())
+                return;
+        }
+
+        appendNode(block);
+    }
+
+    /// Слияние с другой кучей за O((N1 + N2) / B) операций ввода-вывода: элементы other последовательно
+    /// упаковываются в новые вершины в конце, после чего дерево перестраивается снизу вверх. other становится пустой
+    void meld(ExternalHeap&& other)
+    {
+        if (&other == this || other.N == 0)
+            return;
+
+        int64_t nodeNum = nodesCount;
+        std::vector<T> carry;
+        int64_t carryWeight = 0;
+        if (nodesCount > 0)
+        {
+            // Последняя вершина кучи будет перезаписана
+            carry = readLast();
+            carryWeight = lastWeight;
+            --nodeNum;
+        }
+
+        for (int64_t i = 0; i < other.nodesCount; ++i)
+        {
+            std::vector<T> node = other.readNode(i);
+            for (size_t j = 0; j < node.size(); ++j)
+            {
+                int64_t w = ExternalCodec<T>::size(node[j]);
+                if (!carry.empty() && carryWeight + w > budget)
+                {
+                    std::sort(carry.begin(), carry.end(), std::greater<T>());
+                    storage.writeBlock(nodeNum++, carry);
+                    carry.clear();
+                    carryWeight = 0;
+                }
+                carry.push_back(node[j]);
+                carryWeight += w;
+            }
+        }
+        std::sort(carry.begin(), carry.end(), std::greater<T>());
+        storage.writeBlock(nodeNum++, carry);
+
+        N += other.N;
+        nodesCount = nodeNum;
+        lastCount = carry.size();
+        lastWeight = carryWeight;
+        lastTruncated = false;
+        other.N = 0;
+        other.nodesCount = 0;
+        other.lastCount = -1;
+        other.lastTruncated = false;
+
+        // Построение кучи снизу вверх: суммарная длина всех просеиваний - O(количества вершин)
+        for (int64_t i = nodesCount / 2 - 1; i >= 0; --i)
+        {
+            std::vector<T> node = readNode(i);
+            siftDown(i, node);
+        }
+    }
+
+    /// Пустая ли куча
+    bool empty() const
+    {
+        return N == 0;
+    }
+
+    /// Получить количество элементов в куче
+    int64_t size() const
+    {
+        return N;
+    }
+
+    /// Получить максимальный элемент (но не извлекать)
+    T getMax() const
+    {
+        if (N == 0)
+            throw NoElementsInHeapException();
+
+        return readNode(0)[0];
+    }
+
+    /// Получить блок максимальных элементов (но не извлекать)
+    std::vector<T> getMaxBlock() const
+    {
+        if (N == 0)
+            throw NoElementsInHeapException();
+
+        return readNode(0);
+    }
+
+    /// Извлечь максимальный элемент (эффективнее извлекать блок максимальных элементов, если есть возможность)
+    T extractMax()
+    {
+        if (N == 0)
+            throw NoElementsInHeapException();
+
+        std::vector<T> root = readNode(0);
+        T res = root[0];
+        --N;
+
+        if (nodesCount == 1)
+        {
+            root.erase(root.begin());
+            if (root.empty())
+                clearNodes();
+            else
+                writeNode(0, root);
+            return res;
+        }
+
+        // На место максимума - наименьший элемент последней вершины, сама она не перезаписывается
+        std::vector<T> last = readLast();
+        root[0] = last.back();
+        std::sort(root.begin(), root.end(), std::greater<T>());
+        if (--lastCount > 0)
+        {
+            lastWeight -= ExternalCodec<T>::size(last.back());
+            lastTruncated = true;
+        }
+        else
+            removeLast();
+
+        siftDown(0, root);
+
+        return res;
+    }
+
+    /// Извлечь блок максимальных элементов
+    std::vector<T> extractMaxBlock()
+    {
+        if (N == 0)
+            throw NoElementsInHeapException();
+
+        std::vector<T> res = readNode(0);
+        N -= res.size();
+        if (nodesCount == 1)
+        {
+            clearNodes();
+            return res;
+        }
+
+        std::vector<T> last = readLast();
+        removeLast();
+        if (nodesCount > 1)  // Дополняем последнюю вершину наименьшими элементами предпоследней, сколько поместится
+        {
+            std::vector<T> preLast = readLast();
+            int64_t w = weightOf(last.begin(), last.end());
+            size_t taken = 0;
+            while (taken + 1 < preLast.size() && w + int64_t(ExternalCodec<T>::size(preLast[preLast.size() - 1 - taken])) <= budget)
+                w += ExternalCodec<T>::size(preLast[preLast.size() - 1 - taken++]);
+
+            if (taken > 0)
+            {
+                last.insert(last.end(), preLast.end() - taken, preLast.end());
+                std::sort(last.begin(), last.end(), std::greater<T>());
+                lastCount -= taken;
+                lastWeight -= weightOf(preLast.end() - taken, preLast.end());
+                lastTruncated = true;
+            }
+        }
+
+        siftDown(0, last);
+
+        return res;
+    }
+
+    /// Распечатать содержимое кучи (использовать только для отладки)
+    void debugPrint() const
+    {
+        printf("=================================================\n");
+        printf("Elements in heap:   %ld\n", N);
+        printf("Bytes per block:    %ld\n\n", budget);
+
+        for (int64_t i = 0; i < nodesCount; ++i)
+        {
+            std::vector<T> node = readNode(i);
+
+            printf("Block %2ld: ", i);
+            for (size_t j = 0; j < node.size(); ++j)
+            {
+                std::cout << std::setw(5) << node[j];
+            }
+            printf("\n");
+        }
+        printf("\n");
+    }
+
+    /// Создать dot-файл (использовать только для отладки)
+    /// Команда для конвертации в ps: dot -Tps extheap.dot -o extheap.ps
+    void exportToDOT(std::string const& fileName) const
+    {
+        FILE* f = fopen(fileName.c_str(), "w");
+        fprintf(f, "graph Heap {\n  node [shape=box];");
+        for (int64_t i = 0; i < nodesCount; ++i)
+        {
+            std::vector<T> node = readNode(i);
+            std::string bStr;
+            for (size_t j = 0; j < node.size(); ++j)
+                bStr += toString(node[j]) + (j == node.size() - 1 ? "" : ", ");
+            fprintf(f, "  b%ld [label=\"%s\"];\n", i, bStr.c_str());
+        }
+        fprintf(f, "\n");
+        for (int64_t i = 0; i < nodesCount; ++i)
+        {
+            if (i * 2 + 1 < nodesCount)
+                fprintf(f, "  b%ld -- b%ld;\n", i, i * 2 + 1);
+            if (i * 2 + 2 < nodesCount)
+                fprintf(f, "  b%ld -- b%ld;\n", i, i * 2 + 2);
+        }
+        fprintf(f, "}\n");
+        fclose(f);
+    }
+
+    void printStorageStats() const
+    {
+        storage.printStats();
+    }
+
+    /// Суммарное количество чтений и записей блоков
+    int64_t storageIOCount() const
+    {
+        return storage.ioCount();
+    }
+
+    /// Количество дальних переходов по файлу хранилища (см. ExternalStorage::farSeeksCount)
+    int64_t storageSeeksCount() const
+    {
+        return storage.farSeeksCount();
+    }
+
+private:
+    typedef typename std::vector<T>::const_iterator Iterator;
+
+    static int64_t weightOf(Iterator begin, Iterator end)
+    {
+        int64_t res = 0;
+        for (Iterator it = begin; it != end; ++it)
+            res += ExternalCodec<T>::size(*it);
+        return res;
+    }
+
+    /// Вершина кучи; у последней вершины в файле может остаться устаревший хвост, он отбрасывается
+    std::vector<T> readNode(int64_t nodeNum) const
+    {
+        std::vector<T> res = storage.readBlock(nodeNum);
+        if (nodeNum == nodesCount - 1 && lastCount >= 0)
+            res.resize(lastCount);
+        return res;
+    }
+
+    std::vector<T> readLast()
+    {
+        std::vector<T> res = readNode(nodesCount - 1);
+        if (lastCount < 0)
+        {
+            lastCount = res.size();
+            lastWeight = weightOf(res.begin(), res.end());
+            lastTruncated = false;
+        }
+        return res;
+    }
+
+    void writeNode(int64_t nodeNum, std::vector<T>& node)
+    {
+        storage.writeBlock(nodeNum, node);
+        if (nodeNum == nodesCount - 1)
+        {
+            lastCount = node.size();
+            lastWeight = weightOf(node.begin(), node.end());
+            lastTruncated = false;
+        }
+    }
+
+    /// Новая последняя вершина кучи (элементы упорядочены по убыванию)
+    void appendNode(std::vector<T> const& node)
+    {
+        ++nodesCount;
+        lastCount = node.size();
+        lastWeight = weightOf(node.begin(), node.end());
+        lastTruncated = false;
+
+        std::vector<T> block(node);
+        siftUp(nodesCount - 1, block);
+    }
+
+    /// Последняя вершина опустела; новая последняя хранится в файле целиком
+    void removeLast()
+    {
+        --nodesCount;
+        lastCount = -1;
+        lastTruncated = false;
+    }
+
+    void clearNodes()
+    {
+        N = 0;
+        nodesCount = 0;
+        lastCount = -1;
+        lastTruncated = false;
+    }
+
+    /// Сколько элементов из начала упорядоченного по убыванию sorted идёт в верхнюю вершину при делении на две
+    /// (от lo до hi): коды делятся как можно ровнее. Заполнять верхнюю вершину до бюджета невыгодно - тогда
+    /// при следующем делении двух полных вершин одна из них почти всегда не помещается в слот
+    int64_t splitPoint(std::vector<T> const& sorted, int64_t lo, int64_t hi) const
+    {
+        int64_t total = weightOf(sorted.begin(), sorted.end());
+        int64_t prefix = weightOf(sorted.begin(), sorted.begin() + lo);
+        int64_t best = lo;
+        int64_t bestCost = std::max(prefix, total - prefix);
+        for (int64_t k = lo + 1; k <= hi; ++k)
+        {
+            prefix += ExternalCodec<T>::size(sorted[k - 1]);
+            int64_t cost = std::max(prefix, total - prefix);
+            if (cost <= bestCost)
+            {
+                best = k;
+                bestCost = cost;
+            }
+        }
+        return best;
+    }
+
+    /// Количество элементов упорядоченного по убыванию sorted, которые не меньше value
+    static int64_t countNotLess(std::vector<T> const& sorted, T const& value)
+    {
+        return std::upper_bound(sorted.begin(), sorted.end(), value, std::greater<T>()) - sorted.begin();
+    }
+
+    /// Количество элементов упорядоченного по убыванию sorted, которые больше value
+    static int64_t countGreater(std::vector<T> const& sorted, T const& value)
+    {
+        return std::lower_bound(sorted.begin(), sorted.end(), value, std::greater<T>()) - sorted.begin();
+    }
+
+    static std::vector<T> merged(std::vector<T> const& a, std::vector<T> const& b)
+    {
+        std::vector<T> res;
+        std::merge(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(res), std::greater<T>());
+        return res;
+    }
+
+    /// Поднятие больших значений наверх: block - новое содержимое вершины nodeNum
+    void siftUp(int64_t nodeNum, std::vector<T>& block)
+    {
+        while (nodeNum > 0)
+        {
+            int64_t parentNum = (nodeNum - 1) >> 1;
+            std::vector<T> parent = readNode(parentNum);
+            if (!(parent.back() < block[0]))  // Свойство кучи (все элементы родителя >= всех потомка) не нарушено
+                break;
+
+            // Наверх уходят все элементы больше максимума родителя (иначе нарушится свойство кучи с детьми
+            // вершины nodeNum) и только элементы не меньше минимума родителя (иначе - с братом вершины nodeNum)
+            std::vector<T> all = merged(parent, block);
+            int64_t lo = std::max<int64_t>(1, countGreater(all, parent[0]));
+            int64_t hi = std::min<int64_t>(countNotLess(all, parent.back()), all.size() - 1);
+            int64_t k = splitPoint(all, lo, hi);
+
+            std::vector<T> rest(all.begin() + k, all.end());
+            writeNode(nodeNum, rest);
+
+            block.assign(all.begin(), all.begin() + k);
+            nodeNum = parentNum;
+        }
+        writeNode(nodeNum, block);
+    }
+
+    /// Опускание маленьких значений вниз: block - новое содержимое вершины nodeNum
+    void siftDown(int64_t nodeNum, std::vector<T>& block)
+    {
+        while ((nodeNum << 1) + 1 < nodesCount)  // Пока у текущей вершины есть хотя бы один ребёнок
+        {
+            int64_t sonLNum = (nodeNum << 1) + 1;
+            int64_t sonRNum = (nodeNum << 1) + 2;
+            std::vector<T> sonL = readNode(sonLNum);
+
+            if (sonRNum >= nodesCount)  // Если у вершины только 1 сын (в таком случае, он также является последней вершиной кучи)
+            {
+                if (block.back() >= sonL[0])  // Если свойство кучи не нарушено
+                    break;
+
+                std::vector<T> all = merged(block, sonL);
+                int64_t k = splitPoint(all, 1, all.size() - 1);
+                block.assign(all.begin(), all.begin() + k);
+                sonL.assign(all.begin() + k, all.end());
+                writeNode(nodeNum, block);
+                writeNode(sonLNum, sonL);
+                return;
+            }
+
+            std::vector<T> sonR = readNode(sonRNum);
+            bool brokenL = block.back() < sonL[0];
+            bool brokenR = block.back() < sonR[0];
+            if (!brokenL && !brokenR)  // Если свойство кучи не нарушено
+                break;
+
+            if (brokenL != brokenR)  // Если свойство кучи нарушено только с одним сыном
+            {
+                // Вершина делится с этим сыном; в ней остаются только элементы не меньше максимума другого сына
+                // и минимума этого (его дети не больше минимума)
+                std::vector<T> const& son = brokenL ? sonL : sonR;
+                std::vector<T> const& other = brokenL ? sonR : sonL;
+                std::vector<T> all = merged(block, son);
+                int64_t hi = std::min<int64_t>(std::min(countNotLess(all, other[0]), countNotLess(all, son.back())), all.size() - 1);
+                int64_t k = splitPoint(all, 1, hi);
+                block.assign(all.begin(), all.begin() + k);
+                writeNode(nodeNum, block);
+
+                // Далее идём чинить этого сына и под ним
+                nodeNum = brokenL ? sonLNum : sonRNum;
+                block.assign(all.begin() + k, all.end());
+                continue;
+            }
+
+            // Если свойство кучи нарушено для обоих сыновей: в вершине остаются наибольшие элементы (не меньше
+            // обоих минимумов сыновей), сын с наименьшим минимумом получает наименьшие элементы не меньше
+            // этого минимума и больше не меняется, остальное идёт чинить другого сына
+            bool minInR = sonL.back() > sonR.back();
+            int64_t fixedNum = minInR ? sonRNum : sonLNum;
+            int64_t nextNum = minInR ? sonLNum : sonRNum;
+            std::vector<T> all = merged(merged(block, sonL), sonR);
+            int64_t q = countNotLess(all, minInR ? sonR.back() : sonL.back());
+            int64_t kMax = std::min(std::min(q - 1, countNotLess(all, minInR ? sonL.back() : sonR.back())), int64_t(all.size()) - 2);
+
+            int64_t k = 1;
+            int64_t w = ExternalCodec<T>::size(all[0]);
+            while (k < kMax && w + int64_t(ExternalCodec<T>::size(all[k])) <= budget)
+                w += ExternalCodec<T>::size(all[k++]);
+
+            int64_t j = q - 1;
+            w = ExternalCodec<T>::size(all[j]);
+            int64_t jMin = (q == int64_t(all.size())) ? k + 1 : k;  // В другом сыне должен остаться хотя бы один элемент
+            while (j > jMin && w + int64_t(ExternalCodec<T>::size(all[j - 1])) <= budget)
+                w += ExternalCodec<T>::size(all[--j]);
+
+            block.assign(all.begin(), all.begin() + k);
+            writeNode(nodeNum, block);
+            std::vector<T> fixed(all.begin() + j, all.begin() + q);
+            writeNode(fixedNum, fixed);
+
+            // Далее идём чинить другого сына и под ним
+            nodeNum = nextNum;
+            block.assign(all.begin() + k, all.begin() + j);
+            block.insert(block.end(), all.begin() + q, all.end());
+        }
+        writeNode(nodeNum, block);
+    }
+
+    ExternalStorage<T> storage;
+    int64_t budget;  /// Сколько байт кодов элементов помещается в вершину
+    int64_t N;
+    int64_t nodesCount;
+    int64_t lastCount;  /// Количество элементов последней вершины (-1 - все, что в файле)
+    int64_t lastWeight;  /// Размер кодов элементов последней вершины (если lastCount >= 0)
+    bool lastTruncated;  /// В файле у последней вершины есть устаревший хвост
+};
@@ -0,0 +1,436 @@
+#pragma once
+
+#include <cassert>
+#include <functional>
+
+#include "external_heap.h"
+
+/// Внешняя интервальная куча: извлечение как максимальных, так и минимальных элементов.
+/// Каждая вершина хранится одним отсортированным (по убыванию) блоком из 2 * elementsPerBlock элементов:
+/// первая половина вершины (верхняя) >= всех элементов поддерева, вторая половина (нижняя) <= всех элементов поддерева.
+template <class T>
+class ExternalIntervalHeap
+{
+public:
+    /// subtreeHeight - см. ExternalStorage (расположение блоков в файле поддеревьями для локальности путей просеивания),
+    /// bytesPerBlock - размер блока в файле для типов переменной длины (см. ExternalStorage)
+    ExternalIntervalHeap(std::string const& storageFileName, int64_t elementsPerBlock, int64_t subtreeHeight = 1, int64_t bytesPerBlock = 0)
+        : storage(storageFileName, 2 * elementsPerBlock, true, subtreeHeight, 2 * bytesPerBlock)
+        , elementsPerBlock(elementsPerBlock)
+        , elementsPerNode(2 * elementsPerBlock)
+        , N(0)
+    {
+    }
+
+    /// Куча в многоуровневом хранилище (см. StorageTier)
+    ExternalIntervalHeap(std::vector<StorageTier> const& storageTiers, int64_t elementsPerBlock, int64_t subtreeHeight = 1, int64_t bytesPerBlock = 0)
+        : storage(storageTiers, 2 * elementsPerBlock, true, subtreeHeight, 2 * bytesPerBlock)
+        , elementsPerBlock(elementsPerBlock)
+        , elementsPerNode(2 * elementsPerBlock)
+        , N(0)
+    {
+    }
+
+    ~ExternalIntervalHeap()
+    {
+    }
+
+    /// Добавление элемента (эффективнее добавлять блок элементов, если есть возможность)
+    void insert(T const& element)
+    {
+        std::vector<T> block(1, element);
+        insert(block);
+    }
+
+    /// Добавление блока элементов (максимальный размер блока elementsPerBlock)
+    void insert(std::vector<T>& block)
+    {
+        if (block.size() > elementsPerBlock)
+            throw TooLargeBlockException();
+        if (block.empty())
+            return;
+
+        int64_t nodeNum = N / elementsPerNode;
+        std::vector<T> node;
+        if ((N % elementsPerNode) > 0)
+            node = readNode(nodeNum);  // Используем последнюю недозаполненную вершину кучи
+
+        if (node.size() + block.size() <= elementsPerNode)
+        {
+            node.insert(node.end(), block.begin(), block.end());
+            N += block.size();
+            std::sort(node.begin(), node.end(), std::greater<T>());
+            siftUp(nodeNum, node);
+            return;
+        }
+
+        int64_t toFill = elementsPerNode - node.size();
+        node.insert(node.end(), block.begin(), block.begin() + toFill);
+        std::vector<T> newBlock(block.begin() + toFill, block.end());
+        N += toFill;
+        assert((N % elementsPerNode) == 0);
+        std::sort(node.begin(), node.end(), std::greater<T>());
+        siftUp(nodeNum, node);
+
+        insert(newBlock);
+    }
+
+    /// Пустая ли куча
+    bool empty() const
+    {
+        return N == 0;
+    }
+
+    /// Получить количество элементов в куче
+    int64_t size() const
+    {
+        return N;
+    }
+
+    /// Получить максимальный элемент (но не извлекать)
+    T getMax() const
+    {
+        if (N == 0)
+            throw NoElementsInHeapException();
+
+        return readNode(0).front();
+    }
+
+    /// Получить минимальный элемент (но не извлекать)
+    T getMin() const
+    {
+        if (N == 0)
+            throw NoElementsInHeapException();
+
+        return readNode(0).back();
+    }
+
+    /// Получить блок максимальных элементов (но не извлекать), элементы упорядочены по убыванию
+    std::vector<T> getMaxBlock() const
+    {
+        if (N == 0)
+            throw NoElementsInHeapException();
+
+        std::vector<T> res = readNode(0);
+        if (res.size() > elementsPerBlock)
+            res.resize(elementsPerBlock);
+        return res;
+    }
+
+    /// Получить блок минимальных элементов (но не извлекать), элементы упорядочены по возрастанию
+    std::vector<T> getMinBlock() const
+    {
+        if (N == 0)
+            throw NoElementsInHeapException();
+
+        std::vector<T> res = readNode(0, true);
+        if (res.size() > elementsPerBlock)
+            res.resize(elementsPerBlock);
+        return res;
+    }
+
+    /// Извлечь максимальный элемент (эффективнее извлекать блок максимальных элементов, если есть возможность)
+    T extractMax()
+    {
+        return extractOne(false);
+    }
+
+    /// Извлечь минимальный элемент (эффективнее извлекать блок минимальных элементов, если есть возможность)
+    T extractMin()
+    {
+        return extractOne(true);
+    }
+
+    /// Извлечь блок максимальных элементов, элементы упорядочены по убыванию
+    std::vector<T> extractMaxBlock()
+    {
+        return extractBlock(false);
+    }
+
+    /// Извлечь блок минимальных элементов, элементы упорядочены по возрастанию
+    std::vector<T> extractMinBlock()
+    {
+        return extractBlock(true);
+    }
+
+    /// Распечатать содержимое кучи (использовать только для отладки)
+    void debugPrint() const
+    {
+        printf("=================================================\n");
+        printf("Elements in heap:   %ld\n", N);
+        printf("Elements per block: %ld\n\n", elementsPerBlock);
+
+        int64_t nCount = nodesCount();
+        for (int64_t i = 0; i < nCount; ++i)
+        {
+            std::vector<T> node = readNode(i);
+
+            printf("Node %2ld: ", i);
+            for (size_t j = 0; j < node.size(); ++j)
+            {
+                if (j == elementsPerBlock)
+                    printf("  |");
+                std::cout << std::setw(5) << node[j];
+            }
+            printf("\n");
+        }
+        printf("\n");
+    }
+
+    void printStorageStats() const
+    {
+        storage.printStats();
+    }
+
+private:
+    int64_t nodesCount() const
+    {
+        return (N + elementsPerNode - 1) / elementsPerNode;
+    }
+
+    /// Количество элементов в вершине (неполной может быть только последняя)
+    int64_t nodeSize(int64_t nodeNum) const
+    {
+        if (nodeNum == N / elementsPerNode)
+            return N % elementsPerNode;
+        return elementsPerNode;
+    }
+
+    /// Чтение вершины; при ascending элементы упорядочены по возрастанию (для работы с минимальной стороной)
+    std::vector<T> readNode(int64_t nodeNum, bool ascending = false) const
+    {
+        std::vector<T> node = storage.readBlock(nodeNum);
+        node.resize(nodeSize(nodeNum));
+        if (ascending)
+            std::reverse(node.begin(), node.end());
+        return node;
+    }
+
+    void writeNode(int64_t nodeNum, std::vector<T>& node, bool ascending = false)
+    {
+        if (ascending)
+            std::reverse(node.begin(), node.end());
+        storage.writeBlock(nodeNum, node);
+    }
+
+    /// Порядок, в котором "лучшие" для текущей стороны элементы идут первыми
+    static bool before(T const& a, T const& b, bool ascending)
+    {
+        return ascending ? a < b : b < a;
+    }
+
+    void sortNode(std::vector<T>& node, bool ascending) const
+    {
+        if (ascending)
+            std::sort(node.begin(), node.end(), std::less<T>());
+        else
+            std::sort(node.begin(), node.end(), std::greater<T>());
+    }
+
+    /// Общая часть extractMax и extractMin: ascending == true означает работу с минимальной стороной
+    T extractOne(bool ascending)
+    {
+        if (N == 0)
+            throw NoElementsInHeapException();
+
+        std::vector<T> root = readNode(0, ascending);
+        T res = root[0];
+
+        if (N <= elementsPerNode)
+        {
+            root.erase(root.begin());
+            --N;
+            writeNode(0, root, ascending);
+            return res;
+        }
+
+        // Замещаем извлечённый элемент последним элементом кучи (он лежит в листе, поэтому его можно забрать без записи)
+        std::vector<T> lastNode = readNode(nodesCount() - 1);
+        root[0] = lastNode.back();
+        --N;
+        sortNode(root, ascending);
+
+        siftDown(0, root, ascending);
+
+        return res;
+    }
+
+    /// Общая часть extractMaxBlock и extractMinBlock
+    std::vector<T> extractBlock(bool ascending)
+    {
+        if (N == 0)
+            throw NoElementsInHeapException();
+
+        std::vector<T> root = readNode(0, ascending);
+        if (N <= elementsPerNode)
+        {
+            int64_t resSize = std::min<int64_t>(N, elementsPerBlock);
+            std::vector<T> res(root.begin(), root.begin() + resSize);
+            root.erase(root.begin(), root.begin() + resSize);
+            N -= resSize;
+            if (N > 0)
+                writeNode(0, root, ascending);
+            return res;
+        }
+
+        std::vector<T> res(root.begin(), root.begin() + elementsPerBlock);
+        root.erase(root.begin(), root.begin() + elementsPerBlock);
+
+        // Забираем elementsPerBlock элементов с конца кучи: хвосты листовых вершин, поэтому записывать их не нужно
+        int64_t nCount = nodesCount();
+        std::vector<T> lastNode = readNode(nCount - 1);
+        int64_t toTake = std::min<int64_t>(elementsPerBlock, lastNode.size());
+        root.insert(root.end(), lastNode.end() - toTake, lastNode.end());
+        if (toTake < elementsPerBlock && nCount > 2)
+        {
+            // Последняя вершина недозаполнена, добираем из предпоследней (она тоже лист)
+            std::vector<T> preLastNode = readNode(nCount - 2);
+            root.insert(root.end(), preLastNode.end() - (elementsPerBlock - toTake), preLastNode.end());
+        }
+        N -= elementsPerBlock;
+
+        sortNode(root, ascending);
+        if (N <= elementsPerNode)  // Осталась одна вершина (при nCount == 2 в root уже попали все оставшиеся элементы)
+        {
+            writeNode(0, root, ascending);
+            return res;
+        }
+
+        siftDown(0, root, ascending);
+
+        return res;
+    }
+
+    /// Поднятие значений наверх: выходящие за интервал родителя элементы обмениваются с его крайними элементами
+    void siftUp(int64_t nodeNum, std::vector<T>& node)
+    {
+        while (nodeNum > 0)
+        {
+            int64_t parentNum = (nodeNum - 1) >> 1;
+            std::vector<T> parent = readNode(parentNum);
+
+            // Если свойство кучи не нарушено (все элементы вершины лежат между половинами родителя)
+            if (!(parent[elementsPerBlock - 1] < node.front()) && !(node.back() < parent[elementsPerBlock]))
+                break;
+
+            // Родителю - elementsPerBlock наибольших и elementsPerBlock наименьших, вершине - середина
+            std::vector<T> merged(parent);
+            merged.insert(merged.end(), node.begin(), node.end());
+            std::sort(merged.begin(), merged.end(), std::greater<T>());
+
+            node.assign(merged.begin() + elementsPerBlock, merged.end() - elementsPerBlock);
+            storage.writeBlock(nodeNum, node);
+
+            parent.assign(merged.begin(), merged.begin() + elementsPerBlock);
+            parent.insert(parent.end(), merged.end() - elementsPerBlock, merged.end());
+            node = parent;
+            nodeNum = parentNum;
+        }
+        storage.writeBlock(nodeNum, node);
+    }
+
+    /// Обмен "верхними" частями: в toBeBetter в итоге будут лучшие для текущей стороны значения из первых
+    /// elementsPerBlock элементов обеих вершин, после чего обе вершины пересортировываются
+    void remergeFronts(std::vector<T>& toBeBetter, std::vector<T>& toBeWorse, bool ascending) const
+    {
+        std::vector<T> fronts(toBeBetter.begin(), toBeBetter.begin() + elementsPerBlock);
+        fronts.insert(fronts.end(), toBeWorse.begin(), toBeWorse.begin() + elementsPerBlock);
+        sortNode(fronts, ascending);
+
+        std::copy(fronts.begin(), fronts.begin() + elementsPerBlock, toBeBetter.begin());
+        std::copy(fronts.begin() + elementsPerBlock, fronts.end(), toBeWorse.begin());
+        sortNode(toBeBetter, ascending);
+        sortNode(toBeWorse, ascending);
+    }
+
+    /// Опускание значений вниз по одной стороне интервала (для ascending - по минимальной).
+    /// node - полная вершина, упорядоченная по стороне; нарушено может быть только свойство её первой половины
+    void siftDown(int64_t nodeNum, std::vector<T>& node, bool ascending)
+    {
+        int64_t nCount = nodesCount();
+
+        while ((nodeNum << 1) + 1 < nCount)  // Пока у текущей вершины есть хотя бы один ребёнок
+        {
+            int64_t sonLNum = (nodeNum << 1) + 1;
+            int64_t sonRNum = (nodeNum << 1) + 2;
+            T const& border = node[elementsPerBlock - 1];
+
+            std::vector<T> sonL = readNode(sonLNum, ascending);
+            std::vector<T> sonR;
+            if (sonRNum < nCount)
+                sonR = readNode(sonRNum, ascending);
+
+            bool brokenL = before(sonL[0], border, ascending);
+            bool brokenR = !sonR.empty() && before(sonR[0], border, ascending);
+            if (!brokenL && !brokenR)  // Если свойство кучи не нарушено
+                break;
+
+            if ((sonLNum << 1) + 1 >= nCount)
+            {
+                // Сыновья - листья: просто перераспределяем элементы, сохраняя размеры вершин
+                std::vector<T> merged(node.begin(), node.begin() + elementsPerBlock);
+                merged.insert(merged.end(), sonL.begin(), sonL.end());
+                merged.insert(merged.end(), sonR.begin(), sonR.end());
+                sortNode(merged, ascending);
+
+                std::copy(merged.begin(), merged.begin() + elementsPerBlock, node.begin());
+                sonL.assign(merged.begin() + elementsPerBlock, merged.begin() + elementsPerBlock + sonL.size());
+                sonR.assign(merged.begin() + elementsPerBlock + sonL.size(), merged.end());
+
+                writeNode(nodeNum, node, ascending);
+                writeNode(sonLNum, sonL, ascending);
+                if (!sonR.empty())
+                    writeNode(sonRNum, sonR, ascending);
+                return;
+            }
+
+            // Оба сына - полные вершины (левый - внутренняя)
+            if (!brokenR || !brokenL)  // Если свойство кучи нарушено только с одним сыном
+            {
+                int64_t sonNum = brokenL ? sonLNum : sonRNum;
+                std::vector<T>& son = brokenL ? sonL : sonR;
+                remergeFronts(node, son, ascending);
+                writeNode(nodeNum, node, ascending);
+
+                // Далее идём чинить сына и под ним
+                nodeNum = sonNum;
+                node = son;
+                continue;
+            }
+
+            // Если свойство кучи нарушено для обоих сыновей: вершине - лучшие из трёх первых половин,
+            // сыну с худшей первой половиной - следующие (они не хуже его собственных, поэтому его свойство сохраняется),
+            // оставшиеся уходят к другому сыну, который и чиним дальше
+            std::vector<T> fronts(node.begin(), node.begin() + elementsPerBlock);
+            fronts.insert(fronts.end(), sonL.begin(), sonL.begin() + elementsPerBlock);
+            fronts.insert(fronts.end(), sonR.begin(), sonR.begin() + elementsPerBlock);
+            sortNode(fronts, ascending);
+
+            bool worseIsL = !before(sonL[elementsPerBlock - 1], sonR[elementsPerBlock - 1], ascending);
+            std::vector<T>& worse = worseIsL ? sonL : sonR;
+            std::vector<T>& other = worseIsL ? sonR : sonL;
+            int64_t worseNum = worseIsL ? sonLNum : sonRNum;
+            int64_t otherNum = worseIsL ? sonRNum : sonLNum;
+
+            std::copy(fronts.begin(), fronts.begin() + elementsPerBlock, node.begin());
+            std::copy(fronts.begin() + elementsPerBlock, fronts.begin() + 2 * elementsPerBlock, worse.begin());
+            std::copy(fronts.begin() + 2 * elementsPerBlock, fronts.end(), other.begin());
+            sortNode(node, ascending);
+            sortNode(worse, ascending);
+            sortNode(other, ascending);
+
+            writeNode(nodeNum, node, ascending);
+            writeNode(worseNum, worse, ascending);
+
+            // Далее идём чинить другого сына и под ним
+            nodeNum = otherNum;
+            node = other;
+        }
+        writeNode(nodeNum, node, ascending);
+    }
+
+    ExternalStorage<T> storage;
+    int64_t elementsPerBlock;
+    int64_t elementsPerNode;
+    int64_t N;
+};
@@ -1,96 +1,771 @@
+#pragma once
+
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
 #include <vector>
 #include <string>
+#include <type_traits>
+
+#include "external_codec.h"
+
+/// Уровень хранилища: файл, максимальное количество блоков в нём (0 - без ограничения) и количество нижних
+/// уровней дерева, которые в нём не хранятся (0 - без ограничения). Уровни хранилища заполняются по порядку
+/// целыми уровнями дерева: первому достаются верхние. При coldLevels > 0 граница сдвигается вниз по мере
+/// роста дерева, и уровень дерева переносится в файл выше постепенно, по блоку на каждую запись
+struct StorageTier
+{
+    std::string fileName;
+    int64_t maxBlocks;
+    int64_t coldLevels;
+
+    StorageTier(std::string const& fileName, int64_t maxBlocks = 0, int64_t coldLevels = 0)
+        : fileName(fileName)
+        , maxBlocks(maxBlocks)
+        , coldLevels(coldLevels)
+    {
+    }
+};
 
+struct BadStorageConfigException {};
+struct StorageConfigMismatchException {};
+
+/// Элементы кодируются через ExternalCodec<T>. Для тривиальных типов блок - это просто elementsPerBlock
+/// элементов подряд. Для остальных блок - слот из bytesPerBlock байт: заголовок слота и начало кодов элементов;
+/// количество элементов в блоке может быть любым (elementsPerBlock = 0) или не больше elementsPerBlock.
+/// Блок, не поместившийся в слот, дописывается в свой участок файла переполнения (<имя файла>.overflow);
+/// на остальные блоки и размер слота это не влияет.
+/// В начале каждого файла - заголовок с параметрами хранилища, они проверяются при повторном открытии
 template <class T>
 class ExternalStorage
 {
 public:
-    ExternalStorage(std::string const& storageFileName, int64_t elementsPerBlock, bool clearStorage = false)
-        : storageFileName(storageFileName)
-        , elementsPerBlock(elementsPerBlock)
-        , blockSize(elementsPerBlock * sizeof(T))
+    /// subtreeHeight - высота поддеревьев, блоки каждого из которых лежат в файле подряд (1 - обычный порядок в ширину),
+    /// bytesPerBlock - размер слота в байтах, обязателен для нетривиальных типов (для тривиальных не используется)
+    ExternalStorage(std::string const& storageFileName, int64_t elementsPerBlock, bool clearStorage = false, int64_t subtreeHeight = 1,
+                    int64_t bytesPerBlock = 0)
+        : elementsPerBlock(elementsPerBlock)
+        , blockSize(slotSize(elementsPerBlock, bytesPerBlock))
+        , subtreeHeight(subtreeHeight)
+        , subtreeBlocks(0)
+        , levelsCount(0)
         , readsCount(0)
         , writesCount(0)
+        , seeksCount(0)
+    {
+        init(std::vector<StorageTier>(1, StorageTier(storageFileName)), clearStorage);
+    }
+
+    /// Хранилище из нескольких файлов (например, верхние уровни дерева на tmpfs/NVMe, остальные на HDD).
+    /// Для ExternalHeap разбиение незаметно: номера блоков те же, что и при одном файле
+    ExternalStorage(std::vector<StorageTier> const& storageTiers, int64_t elementsPerBlock, bool clearStorage = false, int64_t subtreeHeight = 1,
+                    int64_t bytesPerBlock = 0)
+        : elementsPerBlock(elementsPerBlock)
+        , blockSize(slotSize(elementsPerBlock, bytesPerBlock))
+        , subtreeHeight(subtreeHeight)
+        , subtreeBlocks(0)
+        , levelsCount(0)
+        , readsCount(0)
+        , writesCount(0)
+        , seeksCount(0)
+    {
+        init(storageTiers, clearStorage);
+    }
+
+    ~ExternalStorage()
+    {
+        writeHeaders();  // Сохраняем состояние незаконченных переносов
+        for (size_t i = 0; i < tiers.size(); ++i)
+            closeTier(tiers[i]);
+    }
+
+    void clear()
+    {
+        levelsCount = 0;
+        migrations.clear();
+        for (size_t i = 0; i < tiers.size(); ++i)
+        {
+            closeTier(tiers[i]);
+            clearTier(tiers[i]);
+        }
+        updateTierBounds();
+        writeHeaders();
+    }
+
+    std::vector<T> readBlock(int64_t blockNum) const
+    {
+        Tier const& tier = tiers[tierNum(blockNum)];
+        blockNum = physicalBlockNum(blockNum);
+        if (blockNum >= tier.blocksCount)
+            return std::vector<T>();
+        return readSlot(tier, blockNum, Trivial());
+    }
+
+    bool writeBlock(int64_t blockNum, std::vector<T>& block)
+    {
+        if (elementsPerBlock > 0 && block.size() > elementsPerBlock)
+            return false;
+
+        if (levelOf(blockNum) >= levelsCount)
+            growLevels(levelOf(blockNum) + 1);
+        saveMigrationProgress(blockNum);
+
+        writeSlot(tiers[tierNum(blockNum)], physicalBlockNum(blockNum), block, Trivial());
+        migrateStep();
+        return true;
+    }
+
+    /// Сколько байт кодов элементов помещается в слот нетривиального блока без файла переполнения
+    int64_t slotCapacity() const
+    {
+        return blockSize - sizeof(SlotHeader) - sizeof(uint32_t);
+    }
+
+    int64_t ioCount() const
+    {
+        return readsCount + writesCount;
+    }
+
+    /// Количество "дальних" переходов: обращений за пределы окна упреждающего чтения от предыдущего обращения к файлу
+    int64_t farSeeksCount() const
+    {
+        return seeksCount;
+    }
+
+    void printStats() const
+    {
+        printf("%ld\t%ld", readsCount, writesCount);
+        if (tiers.size() > 1)
+        {
+            for (size_t i = 0; i < tiers.size(); ++i)
+                printf("\t%ld/%ld", tiers[i].readsCount, tiers[i].writesCount);
+        }
+        printf("\n");
+    }
+
+private:
+    typedef std::integral_constant<bool, ExternalCodec<T>::trivial> Trivial;
+
+    /// Участок файла переполнения, закреплённый за блоком (переиспользуется при перезаписи блока)
+    struct Extent
+    {
+        int64_t offset;
+        int64_t capacity;
+    };
+
+    struct Tier
+    {
+        std::string fileName;
+        int64_t maxBlocks;
+        int64_t coldLevels;
+        FILE* f;
+        FILE* overflowFile;  /// Только для нетривиальных типов
+        int64_t endLevel;  /// Уровни дерева до endLevel (не включительно) лежат в этом или предыдущих файлах, -1 - без ограничения
+        int64_t blocksCount;
+        int64_t overflowEnd;
+
+        std::map<int64_t, Extent> extents;  /// Участки переполнения по физическому номеру блока (см. rebuildExtents)
+        std::map<int64_t, std::vector<int64_t> > freeExtents;  /// Свободные участки по размеру
+
+        mutable int64_t readsCount;
+        mutable int64_t writesCount;
+        mutable int64_t lastOffset;  /// Конец последнего обращения к файлу (-1 - обращений не было)
+        mutable int64_t lastOverflowOffset;
+    };
+
+    /// Заголовок слота нетривиального блока: размер кодов, участок переполнения (смещение и размер)
+    struct SlotHeader
+    {
+        int64_t payloadSize;
+        int64_t overflowOffset;
+        int64_t overflowCapacity;
+    };
+
+    /// Перенос уровня дерева в другой файл: блоки уровня с позицией меньше progress уже перенесены,
+    /// savedProgress - значение progress в заголовках файлов
+    struct Migration
+    {
+        int64_t level;
+        int64_t fromTier;
+        int64_t toTier;
+        int64_t progress;
+        int64_t savedProgress;
+    };
+
+    static const int64_t maxTiers = 16;
+    static const int64_t maxMigrations = 32;
+    static const int64_t storageMagic = 0x3150414548545845;  // "EXTHEAP1"
+
+    struct Header
+    {
+        int64_t magic;
+        int64_t elementSize;
+        int64_t elementsPerBlock;
+        int64_t blockSize;
+        int64_t subtreeHeight;
+        int64_t tiersCount;
+        int64_t tierNum;
+        int64_t levelsCount;
+        int64_t tierMaxBlocks[maxTiers];
+        int64_t tierColdLevels[maxTiers];
+        int64_t migrationsCount;
+        Migration migrations[maxMigrations];
+    };
+
+    /// Заголовок занимает целую страницу, чтобы блоки оставались выровненными
+    static const int64_t headerSize = 4096;
+    static_assert(sizeof(Header) <= headerSize, "storage header does not fit into its page");
+
+    /// Типичный размер упреждающего чтения (readahead) в Linux
+    static const int64_t readaheadBytes = 128 * 1024;
+
+    /// Поддерево высоты h - это 2^h - 1 блоков; при больших высотах номера в physicalBlockNum переполняются
+    static const int64_t maxSubtreeHeight = 30;
+
+    void init(std::vector<StorageTier> const& storageTiers, bool clearStorage)
+    {
+        if (storageTiers.empty() || storageTiers.size() > maxTiers || subtreeHeight < 1 || subtreeHeight > maxSubtreeHeight
+            || elementsPerBlock < 0 || (ExternalCodec<T>::trivial && elementsPerBlock == 0)
+            || (!ExternalCodec<T>::trivial && blockSize < int64_t(sizeof(SlotHeader) + sizeof(uint32_t))))
+            throw BadStorageConfigException();
+        subtreeBlocks = (int64_t(1) << subtreeHeight) - 1;
+
+        for (size_t i = 0; i < storageTiers.size(); ++i)
+        {
+            Tier tier;
+            tier.fileName = storageTiers[i].fileName;
+            tier.maxBlocks = storageTiers[i].maxBlocks;
+            tier.coldLevels = storageTiers[i].coldLevels;
+            tier.readsCount = 0;
+            tier.writesCount = 0;
+            tier.lastOffset = -1;
+            tier.lastOverflowOffset = -1;
+
+            if (!openTier(tier, storageTiers, i, clearStorage))
+            {
+                for (size_t j = 0; j < tiers.size(); ++j)
+                    closeTier(tiers[j]);
+                throw StorageConfigMismatchException();
+            }
+            tiers.push_back(tier);
+        }
+
+        updateTierBounds();
+        if (!ExternalCodec<T>::trivial && !clearStorage)
+            rebuildExtents();
+        writeHeaders();
+    }
+
+    /// Открытие файла уровня хранилища; false, если файл создан с другими параметрами
+    bool openTier(Tier& tier, std::vector<StorageTier> const& storageTiers, size_t tierIdx, bool clearStorage)
     {
         if (clearStorage)
         {
-            clear();
-            return;
+            clearTier(tier);
+            return true;
         }
 
-        f = fopen(storageFileName.c_str(), "r+");
-        if (f)
+        tier.f = fopen(tier.fileName.c_str(), "r+");
+        if (tier.f)
         {
-            fseek(f, 0, SEEK_END);
-            blocksCount = ftell(f) / blockSize;
-            return;
+            fseek(tier.f, 0, SEEK_END);
+            if (ftell(tier.f) == 0)
+            {
+                fclose(tier.f);
+                clearTier(tier);  // Пустой файл - хранилище создаётся заново
+                return true;
+            }
+
+            // Любой другой файл без нашего заголовка (короткий, чужой) не трогаем
+            Header header;
+            fseek(tier.f, 0, SEEK_SET);
+            if (fread(&header, sizeof(header), 1, tier.f) != 1 || !checkHeader(header, storageTiers, tierIdx))
+            {
+                fclose(tier.f);
+                return false;
+            }
+
+            if (header.levelsCount > levelsCount)
+            {
+                levelsCount = header.levelsCount;
+                migrations.assign(header.migrations, header.migrations + header.migrationsCount);
+            }
+            fseek(tier.f, 0, SEEK_END);
+            tier.blocksCount = (ftell(tier.f) - headerSize) / blockSize;
+            tier.overflowFile = 0;
+            tier.overflowEnd = 0;
+            if (!ExternalCodec<T>::trivial)
+            {
+                tier.overflowFile = fopen((tier.fileName + ".overflow").c_str(), "r+");
+                if (!tier.overflowFile)
+                    tier.overflowFile = fopen((tier.fileName + ".overflow").c_str(), "w+");
+                fseek(tier.overflowFile, 0, SEEK_END);
+                tier.overflowEnd = (ftell(tier.overflowFile) + blockSize - 1) / blockSize * blockSize;  // Файл кончается на хвосте последнего участка
+            }
+            return true;
         }
 
-        clear();  // called here for creating file for storage
+        clearTier(tier);  // called here for creating file for storage
+        return true;
     }
 
-    ~ExternalStorage()
+    bool checkHeader(Header const& header, std::vector<StorageTier> const& storageTiers, size_t tierIdx) const
+    {
+        if (header.magic != storageMagic || header.elementSize != int64_t(sizeof(T)) || header.elementsPerBlock != elementsPerBlock
+            || header.blockSize != blockSize || header.subtreeHeight != subtreeHeight
+            || header.tiersCount != int64_t(storageTiers.size()) || header.tierNum != int64_t(tierIdx))
+            return false;
+        for (size_t i = 0; i < storageTiers.size(); ++i)
+        {
+            if (header.tierMaxBlocks[i] != storageTiers[i].maxBlocks || header.tierColdLevels[i] != storageTiers[i].coldLevels)
+                return false;
+        }
+        return true;
+    }
+
+    void clearTier(Tier& tier)
     {
-        fclose(f);
+        tier.f = fopen(tier.fileName.c_str(), "w+");
+        tier.overflowFile = ExternalCodec<T>::trivial ? 0 : fopen((tier.fileName + ".overflow").c_str(), "w+");
+        tier.blocksCount = 0;
+        tier.overflowEnd = 0;
+        tier.extents.clear();
+        tier.freeExtents.clear();
     }
 
-    void clear()
+    void closeTier(Tier& tier)
     {
-        f = fopen(storageFileName.c_str(), "w+");
-        blocksCount = 0;
+        fclose(tier.f);
+        if (tier.overflowFile)
+            fclose(tier.overflowFile);
     }
 
-    std::vector<T> readBlock(int64_t blockNum) const
+    /// Заголовки переписываются при открытии, при росте дерева на уровень и при закрытии хранилища.
+    /// В счётчики чтений, записей и переходов входят только блоки
+    void writeHeaders()
     {
-        if (blockNum >= blocksCount)
-            return std::vector<T>();
+        Header header;
+        memset(&header, 0, sizeof(header));
+        header.magic = storageMagic;
+        header.elementSize = sizeof(T);
+        header.elementsPerBlock = elementsPerBlock;
+        header.blockSize = blockSize;
+        header.subtreeHeight = subtreeHeight;
+        header.tiersCount = tiers.size();
+        header.levelsCount = levelsCount;
+        for (size_t i = 0; i < tiers.size(); ++i)
+        {
+            header.tierMaxBlocks[i] = tiers[i].maxBlocks;
+            header.tierColdLevels[i] = tiers[i].coldLevels;
+        }
+        for (size_t i = 0; i < migrations.size(); ++i)
+            migrations[i].savedProgress = migrations[i].progress;
+        header.migrationsCount = migrations.size();
+        std::copy(migrations.begin(), migrations.end(), header.migrations);
+
+        for (size_t i = 0; i < tiers.size(); ++i)
+        {
+            header.tierNum = i;
+            fseek(tiers[i].f, 0, SEEK_SET);
+            fwrite(&header, sizeof(header), 1, tiers[i].f);
+            fflush(tiers[i].f);
+        }
+    }
+
+    static int64_t slotSize(int64_t elementsPerBlock, int64_t bytesPerBlock)
+    {
+        if (ExternalCodec<T>::trivial)
+            return elementsPerBlock * sizeof(T);
+        return bytesPerBlock;
+    }
 
+    /// Тривиальный тип: блок читается и пишется как есть
+    std::vector<T> readSlot(Tier const& tier, int64_t physicalNum, std::true_type) const
+    {
         std::vector<T> res(elementsPerBlock);
-        fseek(f, blockSize * blockNum, SEEK_SET);
-        fread(res.data(), sizeof(T), elementsPerBlock, f);
+        countSeek(tier.lastOffset, headerSize + blockSize * physicalNum, blockSize);
+        fseek(tier.f, headerSize + blockSize * physicalNum, SEEK_SET);
+        fread(res.data(), sizeof(T), elementsPerBlock, tier.f);
         ++readsCount;
+        ++tier.readsCount;
         return res;
     }
 
-    bool writeBlock(int64_t blockNum, std::vector<T>& block)
+    void writeSlot(Tier& tier, int64_t physicalNum, std::vector<T>& block, std::true_type)
     {
-        if (block.size() > elementsPerBlock)
-            return false;
         if (block.size() < elementsPerBlock)
             block.resize(elementsPerBlock);
+        writeRaw(tier, physicalNum, reinterpret_cast<char const*>(block.data()));
+    }
+
+    /// Нетривиальный тип: коды элементов (количество элементов - uint32_t, затем коды подряд) лежат в слоте после
+    /// SlotHeader, а не поместившийся хвост - в участке файла переполнения (ещё одно чтение)
+    std::vector<T> readSlot(Tier const& tier, int64_t physicalNum, std::false_type) const
+    {
+        std::vector<char> buf(blockSize);
+        countSeek(tier.lastOffset, headerSize + blockSize * physicalNum, blockSize);
+        fseek(tier.f, headerSize + blockSize * physicalNum, SEEK_SET);
+        fread(buf.data(), 1, blockSize, tier.f);
+        ++readsCount;
+        ++tier.readsCount;
+
+        SlotHeader slotHeader;
+        memcpy(&slotHeader, buf.data(), sizeof(slotHeader));
+
+        int64_t inlineSize = blockSize - sizeof(SlotHeader);
+        std::vector<char> payload(buf.begin() + sizeof(SlotHeader), buf.end());
+        if (slotHeader.payloadSize > inlineSize)
+        {
+            int64_t tailSize = slotHeader.payloadSize - inlineSize;
+            payload.resize(slotHeader.payloadSize);
+            countSeek(tier.lastOverflowOffset, slotHeader.overflowOffset, tailSize);
+            fseek(tier.overflowFile, slotHeader.overflowOffset, SEEK_SET);
+            fread(payload.data() + inlineSize, 1, tailSize, tier.overflowFile);
+            ++readsCount;
+            ++tier.readsCount;
+        }
+
+        uint32_t count;
+        memcpy(&count, payload.data(), sizeof(count));
+        std::vector<T> res(elementsPerBlock > 0 ? elementsPerBlock : count);
+        char const* in = payload.data() + sizeof(count);
+        for (uint32_t i = 0; i < count; ++i)
+            in = ExternalCodec<T>::decode(in, res[i]);
+        return res;
+    }
+
+    void writeSlot(Tier& tier, int64_t physicalNum, std::vector<T>& block, std::false_type)
+    {
+        // Кодируем только переданные элементы, добивку не храним
+        int64_t payloadSize = sizeof(uint32_t);
+        for (size_t i = 0; i < block.size(); ++i)
+            payloadSize += ExternalCodec<T>::size(block[i]);
+
+        int64_t inlineSize = blockSize - sizeof(SlotHeader);
+        std::vector<char> buf(sizeof(SlotHeader) + std::max(payloadSize, inlineSize), 0);
+        uint32_t count = block.size();
+        memcpy(buf.data() + sizeof(SlotHeader), &count, sizeof(count));
+        char* out = buf.data() + sizeof(SlotHeader) + sizeof(count);
+        for (size_t i = 0; i < block.size(); ++i)
+            out = ExternalCodec<T>::encode(block[i], out);
+        if (block.size() < elementsPerBlock)
+            block.resize(elementsPerBlock);
+
+        Extent extent = { 0, 0 };
+        if (tier.extents.count(physicalNum))
+            extent = tier.extents[physicalNum];
+        int64_t tailSize = payloadSize - inlineSize;
+        if (tailSize <= 0 && extent.capacity > 0)
+        {
+            // Блок снова помещается в слот, участок переполнения ему больше не нужен
+            releaseExtent(tier, physicalNum);
+            extent.offset = 0;
+            extent.capacity = 0;
+        }
+        else if (tailSize > extent.capacity)
+        {
+            releaseExtent(tier, physicalNum);
+            extent = allocateExtent(tier, tailSize);
+            tier.extents[physicalNum] = extent;
+        }
+
+        SlotHeader slotHeader = { payloadSize, extent.offset, extent.capacity };
+        memcpy(buf.data(), &slotHeader, sizeof(slotHeader));
+        writeRaw(tier, physicalNum, buf.data());
+
+        if (tailSize > 0)
+        {
+            countSeek(tier.lastOverflowOffset, extent.offset, tailSize);
+            fseek(tier.overflowFile, extent.offset, SEEK_SET);
+            fwrite(buf.data() + blockSize, 1, tailSize, tier.overflowFile);
+            fflush(tier.overflowFile);
+            ++writesCount;
+            ++tier.writesCount;
+        }
+    }
+
+    /// Размер участка переполнения - хвост блока, округлённый вверх до размера слота. Берётся наименьший
+    /// подходящий свободный участок, его остаток снова становится свободным
+    Extent allocateExtent(Tier& tier, int64_t size)
+    {
+        Extent extent = { tier.overflowEnd, (size + blockSize - 1) / blockSize * blockSize };
 
-        if (blockNum >= blocksCount)
+        typename std::map<int64_t, std::vector<int64_t> >::iterator it = tier.freeExtents.lower_bound(extent.capacity);
+        if (it == tier.freeExtents.end())
         {
-            if (blockNum > blocksCount)
+            tier.overflowEnd += extent.capacity;
+            return extent;
+        }
+
+        int64_t freeCapacity = it->first;
+        extent.offset = it->second.back();
+        it->second.pop_back();
+        if (it->second.empty())
+            tier.freeExtents.erase(it);
+        if (freeCapacity > extent.capacity)
+            tier.freeExtents[freeCapacity - extent.capacity].push_back(extent.offset + extent.capacity);
+        return extent;
+    }
+
+    void releaseExtent(Tier& tier, int64_t physicalNum)
+    {
+        typename std::map<int64_t, Extent>::iterator it = tier.extents.find(physicalNum);
+        if (it == tier.extents.end())
+            return;
+        tier.freeExtents[it->second.capacity].push_back(it->second.offset);
+        tier.extents.erase(it);
+    }
+
+    /// Карта участков переполнения не сохраняется: при повторном открытии она восстанавливается по заголовкам
+    /// слотов всех блоков, которые сейчас лежат в файле (у незаконченного переноса - в обоих файлах), а промежутки
+    /// между занятыми участками становятся свободными. Эти чтения, как и заголовки файлов, в счётчики не входят
+    void rebuildExtents()
+    {
+        int64_t blocks = (int64_t(1) << levelsCount) - 1;
+        for (int64_t blockNum = 0; blockNum < blocks; ++blockNum)
+        {
+            int64_t level = levelOf(blockNum);
+            int64_t physicalNum = physicalBlockNum(blockNum);
+            bool migrating = false;
+            for (size_t i = 0; i < migrations.size(); ++i)
             {
-                fseek(f, blockSize * blocksCount, SEEK_SET);
-                for (int64_t i = blocksCount; i < blockNum; ++i)
-                    fwrite(block.data(), sizeof(T), elementsPerBlock, f);  // just filling space with any data
+                if (migrations[i].level != level)
+                    continue;
+                migrating = true;
+                claimExtent(tiers[migrations[i].fromTier], physicalNum);
+                if (blockNum + 1 - (int64_t(1) << level) < migrations[i].progress)
+                    claimExtent(tiers[migrations[i].toTier], physicalNum);
             }
-            blocksCount = blockNum + 1;
+            if (!migrating)
+                claimExtent(tiers[targetTierNum(level)], physicalNum);
         }
 
-        fseek(f, blockSize * blockNum, SEEK_SET);
-        fwrite(block.data(), sizeof(T), elementsPerBlock, f);
-        fflush(f);
+        for (size_t i = 0; i < tiers.size(); ++i)
+        {
+            Tier& tier = tiers[i];
+            std::vector<std::pair<int64_t, int64_t> > used;
+            for (typename std::map<int64_t, Extent>::iterator it = tier.extents.begin(); it != tier.extents.end(); ++it)
+                used.push_back(std::make_pair(it->second.offset, it->second.capacity));
+            used.push_back(std::make_pair(tier.overflowEnd, int64_t(0)));
+            std::sort(used.begin(), used.end());
+
+            int64_t freeBegin = 0;
+            for (size_t j = 0; j < used.size(); ++j)
+            {
+                if (used[j].first > freeBegin)
+                    tier.freeExtents[used[j].first - freeBegin].push_back(freeBegin);
+                freeBegin = std::max(freeBegin, used[j].first + used[j].second);
+            }
+        }
+    }
+
+    void claimExtent(Tier& tier, int64_t physicalNum)
+    {
+        if (tier.overflowEnd == 0 || physicalNum >= tier.blocksCount)
+            return;
+
+        SlotHeader slotHeader;
+        fseek(tier.f, headerSize + blockSize * physicalNum, SEEK_SET);
+        if (fread(&slotHeader, sizeof(slotHeader), 1, tier.f) == 1 && slotHeader.overflowCapacity > 0)
+        {
+            Extent extent = { slotHeader.overflowOffset, slotHeader.overflowCapacity };
+            tier.extents[physicalNum] = extent;
+        }
+    }
+
+    void writeRaw(Tier& tier, int64_t physicalNum, char const* data)
+    {
+        if (physicalNum >= tier.blocksCount)
+            tier.blocksCount = physicalNum + 1;  // Пропущенные блоки не заполняем: запись за концом файла оставляет "дыру"
+
+        countSeek(tier.lastOffset, headerSize + blockSize * physicalNum, blockSize);
+        fseek(tier.f, headerSize + blockSize * physicalNum, SEEK_SET);
+        fwrite(data, 1, blockSize, tier.f);
+        fflush(tier.f);
         ++writesCount;
-        return true;
+        ++tier.writesCount;
     }
 
-    void printStats() const
+    void countSeek(int64_t& lastOffset, int64_t offset, int64_t size) const
     {
-        printf("%ld\t%ld\n", readsCount, writesCount);
+        if (lastOffset < 0 || offset < lastOffset - readaheadBytes || offset > lastOffset + readaheadBytes)
+            ++seeksCount;
+        lastOffset = offset + size;
     }
 
-private:
-    FILE* f;
-    std::string storageFileName;
+    /// Границы уровней хранилища для текущей высоты дерева. Каждый файл получает столько целых уровней дерева,
+    /// сколько помещается в maxBlocks, но не больше levelsCount - coldLevels. Все файлы используют общую
+    /// нумерацию physicalBlockNum (чужие блоки остаются "дырами"), поэтому при сдвиге границ номера блоков не меняются
+    void updateTierBounds()
+    {
+        int64_t level = 0;
+        for (size_t i = 0; i < tiers.size(); ++i)
+        {
+            Tier& tier = tiers[i];
+            if (i + 1 == tiers.size() || level == -1 || (tier.maxBlocks == 0 && tier.coldLevels == 0))
+            {
+                tier.endLevel = -1;
+                level = -1;
+                continue;
+            }
+
+            int64_t end = 62;
+            if (tier.maxBlocks > 0)
+            {
+                // Уровни дерева [level, end) занимают 2^end - 2^level блоков
+                end = level;
+                while (end < 62 && (int64_t(2) << end) - (int64_t(1) << level) <= tier.maxBlocks)
+                    ++end;
+            }
+            if (tier.coldLevels > 0)
+                end = std::min(end, std::max(level, levelsCount - tier.coldLevels));
+
+            tier.endLevel = end;
+            level = end;
+        }
+    }
+
+    /// Файл, в котором уровень дерева должен лежать при текущих границах
+    size_t targetTierNum(int64_t level) const
+    {
+        size_t i = 0;
+        while (tiers[i].endLevel != -1 && level >= tiers[i].endLevel)
+            ++i;
+        return i;
+    }
+
+    /// Файл, в котором блок лежит сейчас (с учётом незаконченных переносов)
+    size_t tierNum(int64_t blockNum) const
+    {
+        int64_t level = levelOf(blockNum);
+        for (size_t i = 0; i < migrations.size(); ++i)
+        {
+            if (migrations[i].level == level)
+                return (blockNum + 1 - (int64_t(1) << level) < migrations[i].progress) ? migrations[i].toTier : migrations[i].fromTier;
+        }
+        return targetTierNum(level);
+    }
+
+    /// Дерево выросло до newLevelsCount уровней: границы сдвигаются, а уровни дерева, сменившие файл,
+    /// ставятся в очередь на перенос
+    void growLevels(int64_t newLevelsCount)
+    {
+        // На перенос уровня уходит меньше записей, чем нужно дереву для роста на следующий уровень,
+        // поэтому предыдущие переносы к этому моменту, как правило, уже закончены
+        while (!migrations.empty())
+            migrateStep();
+
+        std::vector<size_t> oldTiers;
+        for (int64_t level = 0; level < levelsCount; ++level)
+            oldTiers.push_back(targetTierNum(level));
+
+        levelsCount = newLevelsCount;
+        updateTierBounds();
+
+        for (int64_t level = 0; level < int64_t(oldTiers.size()); ++level)
+        {
+            if (targetTierNum(level) == oldTiers[level])
+                continue;
+
+            Migration migration;
+            migration.level = level;
+            migration.fromTier = oldTiers[level];
+            migration.toTier = targetTierNum(level);
+            migration.progress = 0;
+            migration.savedProgress = 0;
+            migrations.push_back(migration);
+        }
+        while (migrations.size() > maxMigrations)
+            migrateStep();
+
+        writeHeaders();
+    }
+
+    /// Перенос одного блока из очереди (вызывается после каждой записи)
+    void migrateStep()
+    {
+        if (migrations.empty())
+            return;
+
+        Migration& migration = migrations.front();
+        int64_t physicalNum = physicalBlockNum((int64_t(1) << migration.level) - 1 + migration.progress);
+        Tier& from = tiers[migration.fromTier];
+        if (physicalNum < from.blocksCount)
+        {
+            std::vector<T> block = readSlot(from, physicalNum, Trivial());
+            writeSlot(tiers[migration.toTier], physicalNum, block, Trivial());
+        }
+
+        if (++migration.progress == (int64_t(1) << migration.level))
+        {
+            // Старые копии уровня больше не нужны: освобождаем их участки переполнения только после
+            // сохранения заголовков, до этого при повторном открытии блоки могут читаться из fromTier
+            Migration finished = migration;
+            migrations.erase(migrations.begin());
+            writeHeaders();
+            for (int64_t i = 0; i < finished.progress; ++i)
+                releaseExtent(from, physicalBlockNum((int64_t(1) << finished.level) - 1 + i));
+        }
+    }
+
+    /// Перед перезаписью уже перенесённого блока состояние переноса сохраняется в заголовках: иначе после
+    /// аварийного завершения процесса блок читался бы из устаревшей копии в fromTier. Блоки, перенесённые
+    /// после последнего сохранения, но не перезаписанные, в обоих файлах одинаковы. От сбоя питания
+    /// это не защищает: файлы не синхронизируются с диском (fsync)
+    void saveMigrationProgress(int64_t blockNum)
+    {
+        int64_t level = levelOf(blockNum);
+        int64_t posInLevel = blockNum + 1 - (int64_t(1) << level);
+        for (size_t i = 0; i < migrations.size(); ++i)
+        {
+            if (migrations[i].level == level && posInLevel < migrations[i].progress && posInLevel >= migrations[i].savedProgress)
+            {
+                writeHeaders();
+                return;
+            }
+        }
+    }
+
+    /// Глубина вершины кучи (корень - уровень 0)
+    static int64_t levelOf(int64_t blockNum)
+    {
+        int64_t depth = 0;
+        while ((int64_t(2) << depth) <= blockNum + 1)
+            ++depth;
+        return depth;
+    }
+
+    /// Номер блока в файле по номеру вершины в куче (дети вершины i - 2i+1 и 2i+2).
+    /// Дерево разбито на поддеревья высоты subtreeHeight, каждое из которых хранится подряд
+    /// (внутри - в ширину), а сами поддеревья упорядочены в ширину; путь от корня до листа
+    /// тогда проходит лишь через глубина / subtreeHeight непрерывных участков файла
+    int64_t physicalBlockNum(int64_t blockNum) const
+    {
+        if (subtreeHeight == 1)
+            return blockNum;
+
+        int64_t depth = levelOf(blockNum);
+        int64_t posInLevel = blockNum + 1 - (int64_t(1) << depth);
+
+        int64_t subtreeLevel = depth / subtreeHeight;
+        int64_t localDepth = depth % subtreeHeight;
+        int64_t subtreesBefore = ((int64_t(1) << (subtreeLevel * subtreeHeight)) - 1) / subtreeBlocks;
+        int64_t subtreeNum = subtreesBefore + (posInLevel >> localDepth);
+        int64_t localNum = (int64_t(1) << localDepth) - 1 + (posInLevel & ((int64_t(1) << localDepth) - 1));
+        return subtreeNum * subtreeBlocks + localNum;
+    }
+
+    std::vector<Tier> tiers;
+    std::vector<Migration> migrations;
     int64_t elementsPerBlock;
-    int64_t blockSize;
-    int64_t blocksCount;
+    int64_t blockSize;  /// Размер слота в файле в байтах
+    int64_t subtreeHeight;
+    int64_t subtreeBlocks;
+    int64_t levelsCount;  /// Количество уровней дерева, в которые что-либо записывалось
 
     mutable int64_t readsCount;
     mutable int64_t writesCount;
+    mutable int64_t seeksCount;
 };
@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <time.h>
+#include <random>
 #include <gtest/gtest.h>
 
 #include "external_heap.h"
@@ -78,11 +79,11 @@ TEST(ExternalHeapTesting, TestWithFewElements)
     heap.printStorageStats();
 }
 
-void TestBlockOperationsWithRandomElements(int64_t count, int64_t blockSize, int64_t insertionBlockSize)
+void TestBlockOperationsWithRandomElements(int64_t count, int64_t blockSize, int64_t insertionBlockSize, int64_t subtreeHeight = 1)
 {
     assert(blockSize >= insertionBlockSize);
 
-    ExternalHeap<int> heap("extheap.data", blockSize);
+    ExternalHeap<int> heap("extheap.data", blockSize, subtreeHeight);
     std::vector<int> testVector;
     for (int64_t i = 0; i < count; ++i)
         testVector.push_back(rand());
@@ -116,9 +117,9 @@ void TestBlockOperationsWithRandomElements(int64_t count, int64_t blockSize, int
     heap.printStorageStats();
 }
 
-void TestOneByOneOperationsWithRandomElements(int64_t count, int64_t blockSize)
+void TestOneByOneOperationsWithRandomElements(int64_t count, int64_t blockSize, int64_t subtreeHeight = 1)
 {
-    ExternalHeap<int> heap("extheap.data", blockSize);
+    ExternalHeap<int> heap("extheap.data", blockSize, subtreeHeight);
     std::vector<int> testVector;
     for (int64_t i = 0; i < count; ++i)
         testVector.push_back(rand());
@@ -157,6 +158,284 @@ TEST(ExternalHeapTesting, TestWith10000Elements)
     TestBlockOperationsWithRandomElements(10000, 4096, 3000);
 }
 
+TEST(ExternalHeapTesting, TestWithSubtreeLayout)
+{
+    TestBlockOperationsWithRandomElements(10000, 16, 16, 3);
+    TestBlockOperationsWithRandomElements(10000, 16, 11, 4);
+
+    TestOneByOneOperationsWithRandomElements(1000, 4, 2);
+    TestOneByOneOperationsWithRandomElements(1000, 4, 3);
+}
+
+int64_t CountSeeksWithSubtreeLayout(int64_t count, int64_t blockSize, int64_t subtreeHeight)
+{
+    std::mt19937 gen(1);  // Последовательность mt19937 одинакова на всех платформах
+    ExternalHeap<int> heap("extheap.data", blockSize, subtreeHeight);
+    std::vector<int> block;
+    for (int64_t i = 0; i < count; i += blockSize)
+    {
+        block.clear();
+        for (int64_t j = 0; j < blockSize && i + j < count; ++j)
+            block.push_back(gen() >> 1);
+        heap.insert(block);
+    }
+    while (!heap.empty())
+        heap.extractMaxBlock();
+
+    return heap.storageSeeksCount();
+}
+
+/// Блоки по 16 КБ: поддерево высоты 3 (7 блоков) целиком попадает в окно упреждающего чтения.
+/// Выигрыш растёт с глубиной дерева (см. results), при 2 млн элементов он около трети
+TEST(ExternalHeapTesting, TestSubtreeLayoutReducesSeeks)
+{
+    int64_t seeksBfs = CountSeeksWithSubtreeLayout(2000000, 4096, 1);
+    int64_t seeksSubtrees = CountSeeksWithSubtreeLayout(2000000, 4096, 3);
+    printf("%ld\t%ld\n", seeksBfs, seeksSubtrees);
+    EXPECT_LT(seeksSubtrees * 4, seeksBfs * 3);
+}
+
+void TestTieredStorageWithRandomElements(std::vector<StorageTier> const& tiers)
+{
+    ExternalHeap<int> heap(tiers, 16);
+    std::vector<int> testVector;
+    for (int64_t i = 0; i < 10000; ++i)
+    {
+        testVector.push_back(rand());
+        heap.insert(testVector.back());
+    }
+
+    std::sort(testVector.begin(), testVector.end(), std::greater<int>());
+
+    int64_t pos = 0;
+    while (!heap.empty())
+    {
+        std::vector<int> next = heap.extractMaxBlock();
+        for (int64_t i = 0; i < next.size(); ++i)
+            EXPECT_EQ(next[i], testVector[pos++]);
+    }
+    EXPECT_EQ(pos, testVector.size());
+
+    heap.printStorageStats();
+}
+
+TEST(ExternalHeapTesting, TestWithTieredStorage)
+{
+    std::vector<StorageTier> tiers;
+    tiers.push_back(StorageTier("extheap_tier0.data", 31));
+    tiers.push_back(StorageTier("extheap_tier1.data", 100));
+    tiers.push_back(StorageTier("extheap_tier2.data"));
+    TestTieredStorageWithRandomElements(tiers);
+
+    // Граница первого файла сдвигается вниз по мере роста кучи
+    tiers[0] = StorageTier("extheap_tier0.data", 0, 3);
+    TestTieredStorageWithRandomElements(tiers);
+}
+
+TEST(ExternalHeapTesting, TestWithStrings)
+{
+    // 512 байт на вершину: длинная строка занимает вершину одна и уходит в файл переполнения
+    ExternalHeap<std::string> heap("extheap.data", 512);
+    ExternalHeap<std::string> heap2("extheap2.data", 256);
+    std::vector<std::string> testVector;
+    for (int64_t i = 0; i < 3000; ++i)
+    {
+        testVector.push_back(std::string((i == 1000) ? 100000 : rand() % 100, 'a' + rand() % 26));
+        if (i < 2000)
+            heap.insert(testVector.back());
+        else
+            heap2.insert(testVector.back());
+    }
+    heap.meld(std::move(heap2));
+
+    std::sort(testVector.begin(), testVector.end(), std::greater<std::string>());
+
+    int64_t pos = 0;
+    while (!heap.empty())
+        EXPECT_EQ(heap.extractMax(), testVector[pos++]);
+    EXPECT_EQ(pos, testVector.size());
+
+    heap.printStorageStats();
+}
+
+/// Строка, дополненная до наибольшей длины, чтобы храниться как есть
+struct PaddedString
+{
+    char data[100];
+};
+
+bool operator<(PaddedString const& s1, PaddedString const& s2)
+{
+    return strcmp(s1.data, s2.data) < 0;
+}
+
+bool operator>(PaddedString const& s1, PaddedString const& s2)
+{
+    return s2 < s1;
+}
+
+bool operator>=(PaddedString const& s1, PaddedString const& s2)
+{
+    return !(s1 < s2);
+}
+
+int64_t fileSize(std::string const& fileName)
+{
+    FILE* f = fopen(fileName.c_str(), "r");
+    fseek(f, 0, SEEK_END);
+    int64_t res = ftell(f);
+    fclose(f);
+    return res;
+}
+
+/// Сравнение количества операций ввода-вывода: вершины, упакованные по байтам, против дополнения каждой строки
+/// до наибольшей длины (фиксированное количество строк в блоке того же размера)
+TEST(ExternalHeapTesting, TestPackedStringsAgainstPadding)
+{
+    const int64_t count = 100000;
+    const int64_t blockSize = 40;
+
+    std::mt19937 gen(1);
+    ExternalHeap<std::string> packed("extheap.data", blockSize * sizeof(PaddedString));
+    ExternalHeap<PaddedString> padded("extheap2.data", blockSize);
+    std::vector<std::string> testVector;
+    for (int64_t i = 0; i < count; i += blockSize)
+    {
+        std::vector<std::string> block;
+        std::vector<PaddedString> paddedBlock;
+        for (int64_t j = 0; j < blockSize; ++j)
+        {
+            block.push_back(std::string(gen() % 100, 'a' + gen() % 26));
+            testVector.push_back(block.back());
+
+            PaddedString s;
+            memset(s.data, 0, sizeof(s.data));
+            memcpy(s.data, block.back().data(), block.back().size());
+            paddedBlock.push_back(s);
+        }
+        packed.insert(block);
+        padded.insert(paddedBlock);
+    }
+    int64_t packedInsertIO = packed.storageIOCount();
+    int64_t paddedInsertIO = padded.storageIOCount();
+
+    std::sort(testVector.begin(), testVector.end(), std::greater<std::string>());
+
+    int64_t pos = 0;
+    while (!packed.empty())
+    {
+        std::vector<std::string> next = packed.extractMaxBlock();
+        for (int64_t i = 0; i < next.size(); ++i)
+            EXPECT_EQ(next[i], testVector[pos++]);
+    }
+    EXPECT_EQ(pos, count);
+    while (!padded.empty())
+        padded.extractMaxBlock();
+
+    int64_t packedExtractIO = packed.storageIOCount() - packedInsertIO;
+    int64_t paddedExtractIO = padded.storageIOCount() - paddedInsertIO;
+    printf("packed: %ld\t%ld\tpadded: %ld\t%ld\n", packedInsertIO, packedExtractIO, paddedInsertIO, paddedExtractIO);
+
+    // Строк за одно чтение больше, поэтому извлечение заметно дешевле; вставка блоками почти не меняется
+    EXPECT_LT(packedExtractIO * 4, paddedExtractIO * 3);
+    EXPECT_LT(packed.storageIOCount(), padded.storageIOCount());
+
+    // В бюджет не укладываются лишь отдельные вершины
+    EXPECT_LT(fileSize("extheap.data.overflow") * 20, fileSize("extheap.data"));
+}
+
+void TestMeldWithRandomElements(int64_t count1, int64_t count2, int64_t blockSize)
+{
+    ExternalHeap<int> heap1("extheap.data", blockSize);
+    ExternalHeap<int> heap2("extheap2.data", blockSize);
+    std::vector<int> testVector;
+    for (int64_t i = 0; i < count1 + count2; ++i)
+    {
+        testVector.push_back(rand());
+        if (i < count1)
+            heap1.insert(testVector.back());
+        else
+            heap2.insert(testVector.back());
+    }
+
+    heap1.meld(std::move(heap2));
+
+    EXPECT_EQ(heap1.size(), count1 + count2);
+    EXPECT_EQ(heap2.size(), 0);
+
+    std::sort(testVector.begin(), testVector.end(), std::greater<int>());
+
+    int64_t pos = 0;
+    while (!heap1.empty())
+    {
+        std::vector<int> next = heap1.extractMaxBlock();
+        for (int64_t i = 0; i < next.size(); ++i)
+            EXPECT_EQ(next[i], testVector[pos++]);
+    }
+    EXPECT_EQ(pos, count1 + count2);
+}
+
+TEST(ExternalHeapTesting, TestMeld)
+{
+    TestMeldWithRandomElements(0, 10, 4);
+    TestMeldWithRandomElements(10, 0, 4);
+    TestMeldWithRandomElements(3, 2, 4);
+    TestMeldWithRandomElements(100, 37, 16);
+    TestMeldWithRandomElements(1001, 999, 16);
+    TestMeldWithRandomElements(64, 640, 16);
+    TestMeldWithRandomElements(10000, 20000, 64);
+}
+
+/// Сравнение количества операций ввода-вывода: meld против извлечения блоков из одной кучи и вставки в другую
+TEST(ExternalHeapTesting, TestMeldAgainstReinsertion)
+{
+    const int64_t count = 200000;
+    const int64_t blockSize = 64;
+
+    ExternalHeap<int> melded1("extheap.data", blockSize);
+    ExternalHeap<int> melded2("extheap2.data", blockSize);
+    ExternalHeap<int> reinserted1("extheap3.data", blockSize);
+    ExternalHeap<int> reinserted2("extheap4.data", blockSize);
+
+    std::vector<int> block;
+    for (int64_t i = 0; i < count; i += blockSize)
+    {
+        block.clear();
+        for (int64_t j = 0; j < blockSize; ++j)
+            block.push_back(rand());
+        std::vector<int> copy = block;
+        if (i < count / 2)
+        {
+            melded1.insert(block);
+            reinserted1.insert(copy);
+        }
+        else
+        {
+            melded2.insert(block);
+            reinserted2.insert(copy);
+        }
+    }
+
+    int64_t meldIO = melded1.storageIOCount() + melded2.storageIOCount();
+    melded1.meld(std::move(melded2));
+    meldIO = melded1.storageIOCount() + melded2.storageIOCount() - meldIO;
+
+    int64_t reinsertIO = reinserted1.storageIOCount() + reinserted2.storageIOCount();
+    while (!reinserted2.empty())
+    {
+        block = reinserted2.extractMaxBlock();
+        reinserted1.insert(block);
+    }
+    reinsertIO = reinserted1.storageIOCount() + reinserted2.storageIOCount() - reinsertIO;
+
+    printf("meld: %ld\treinsertion: %ld\n", meldIO, reinsertIO);
+    EXPECT_LT(meldIO * 3, reinsertIO);
+
+    while (!melded1.empty())
+        EXPECT_EQ(melded1.extractMaxBlock(), reinserted1.extractMaxBlock());
+    EXPECT_EQ(reinserted1.size(), 0);
+}
+
 TEST(ExternalHeapTesting, TestWithDifferentCountsOfElements)
 {
     for (int64_t count = 10000; count <= 2000000; count += 10000)
@@ -0,0 +1,156 @@
+#include <stdlib.h>
+#include <time.h>
+#include <deque>
+#include <set>
+#include <gtest/gtest.h>
+
+#include "external_interval_heap.h"
+
+TEST(ExternalIntervalHeapTesting, TestWithFewElements)
+{
+    ExternalIntervalHeap<int32_t> heap("extheap.data", 2);
+
+    heap.insert(5);
+    heap.insert(1);
+    heap.insert(3);
+    heap.insert(6);
+    heap.insert(4);
+    heap.insert(8);
+    heap.insert(2);
+
+    EXPECT_EQ(heap.size(), 7);
+    EXPECT_EQ(heap.getMax(), 8);
+    EXPECT_EQ(heap.getMin(), 1);
+
+    std::vector<int32_t> minBlock = heap.extractMinBlock();
+    EXPECT_EQ(minBlock.size(), 2);
+    EXPECT_EQ(minBlock[0], 1);
+    EXPECT_EQ(minBlock[1], 2);
+
+    std::vector<int32_t> maxBlock = heap.extractMaxBlock();
+    EXPECT_EQ(maxBlock.size(), 2);
+    EXPECT_EQ(maxBlock[0], 8);
+    EXPECT_EQ(maxBlock[1], 6);
+
+    EXPECT_EQ(heap.extractMin(), 3);
+    EXPECT_EQ(heap.extractMax(), 5);
+    EXPECT_EQ(heap.extractMax(), 4);
+    EXPECT_EQ(heap.size(), 0);
+
+    heap.printStorageStats();
+}
+
+/// Извлечение блоками попеременно с обеих сторон, сверка с отсортированным массивом
+void TestBlockOperationsWithRandomElements(int64_t count, int64_t blockSize, int64_t insertionBlockSize)
+{
+    assert(blockSize >= insertionBlockSize);
+
+    ExternalIntervalHeap<int> heap("extheap.data", blockSize);
+    std::vector<int> testVector;
+    for (int64_t i = 0; i < count; ++i)
+        testVector.push_back(rand());
+
+    std::vector<int> forInsertion;
+    for (int64_t i = 0; i < count; i += insertionBlockSize)
+    {
+        forInsertion.clear();
+        forInsertion.insert(forInsertion.end(), testVector.begin() + i, (i + insertionBlockSize < count) ? testVector.begin() + i + insertionBlockSize : testVector.end());
+        heap.insert(forInsertion);
+    }
+
+    EXPECT_EQ(heap.size(), count);
+
+    std::sort(testVector.begin(), testVector.end(), std::greater<int>());
+    std::deque<int> expected(testVector.begin(), testVector.end());
+
+    std::vector<int> next;
+    bool fromMax = true;
+    while (!heap.empty())
+    {
+        next = fromMax ? heap.extractMaxBlock() : heap.extractMinBlock();
+        EXPECT_EQ(heap.empty() || (next.size() == blockSize), true);
+        for (int64_t i = 0; i < next.size(); ++i)
+        {
+            EXPECT_EQ(next[i], fromMax ? expected.front() : expected.back());
+            if (fromMax)
+                expected.pop_front();
+            else
+                expected.pop_back();
+        }
+        fromMax = !fromMax;
+    }
+
+    EXPECT_EQ(expected.size(), 0);
+    EXPECT_EQ(heap.size(), 0);
+
+    heap.printStorageStats();
+}
+
+/// Случайная смесь вставок и извлечений по одному элементу с обеих сторон
+void TestOneByOneOperationsWithRandomElements(int64_t count, int64_t blockSize)
+{
+    ExternalIntervalHeap<int> heap("extheap.data", blockSize);
+    std::multiset<int> expected;
+
+    for (int64_t i = 0; i < count; ++i)
+    {
+        int val = rand();
+        heap.insert(val);
+        expected.insert(val);
+
+        if (rand() % 3 == 0)
+        {
+            if (rand() % 2 == 0)
+            {
+                EXPECT_EQ(heap.extractMax(), *expected.rbegin());
+                expected.erase(--expected.end());
+            }
+            else
+            {
+                EXPECT_EQ(heap.extractMin(), *expected.begin());
+                expected.erase(expected.begin());
+            }
+        }
+    }
+
+    EXPECT_EQ(heap.size(), expected.size());
+
+    while (!heap.empty())
+    {
+        EXPECT_EQ(heap.getMin(), *expected.begin());
+        EXPECT_EQ(heap.extractMax(), *expected.rbegin());
+        expected.erase(--expected.end());
+    }
+
+    EXPECT_EQ(expected.size(), 0);
+
+    heap.printStorageStats();
+}
+
+TEST(ExternalIntervalHeapTesting, TestWith100Elements)
+{
+    TestBlockOperationsWithRandomElements(100, 4, 4);
+    TestBlockOperationsWithRandomElements(100, 4, 3);
+    TestBlockOperationsWithRandomElements(100, 16, 11);
+
+    TestOneByOneOperationsWithRandomElements(100, 2);
+    TestOneByOneOperationsWithRandomElements(100, 16);
+}
+
+TEST(ExternalIntervalHeapTesting, TestWith10000Elements)
+{
+    TestBlockOperationsWithRandomElements(10000, 16, 16);
+    TestBlockOperationsWithRandomElements(10000, 64, 50);
+    TestBlockOperationsWithRandomElements(10000, 4096, 3000);
+
+    TestOneByOneOperationsWithRandomElements(10000, 4);
+    TestOneByOneOperationsWithRandomElements(10000, 32);
+}
+
+int main(int argc, char* argv[])
+{
+    srand(time(0));
+
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -62,6 +62,355 @@ TEST(ExternalStorageTesting, WriteAndReadBlocks)
     }
 }
 
+TEST(ExternalStorageTesting, WriteAndReadBlocksWithSubtreeLayout)
+{
+    const int64_t blocks = 1000;
+    {
+        ExternalStorage<int64_t> storage("storage.data", 2, true, 3);
+
+        for (int64_t i = blocks - 1; i >= 0; i -= 2)
+        {
+            std::vector<int64_t> b(2, i);
+            storage.writeBlock(i, b);
+        }
+        for (int64_t i = 0; i < blocks; i += 2)
+        {
+            std::vector<int64_t> b(2, i);
+            storage.writeBlock(i, b);
+        }
+        EXPECT_EQ(storage.ioCount(), blocks);  // Пропуски в файле ничем не заполняются
+
+        for (int64_t i = 0; i < blocks; ++i)
+            EXPECT_EQ(storage.readBlock(i), std::vector<int64_t>(2, i));
+    }
+    {
+        ExternalStorage<int64_t> storage("storage.data", 2, false, 3);
+
+        for (int64_t i = 0; i < blocks; ++i)
+            EXPECT_EQ(storage.readBlock(i), std::vector<int64_t>(2, i));
+    }
+}
+
+int64_t fileSize(std::string const& fileName)
+{
+    FILE* f = fopen(fileName.c_str(), "r");
+    fseek(f, 0, SEEK_END);
+    int64_t res = ftell(f);
+    fclose(f);
+    return res;
+}
+
+TEST(ExternalStorageTesting, WriteAndReadBlocksWithTiers)
+{
+    std::vector<StorageTier> tiers;
+    tiers.push_back(StorageTier("storage_tier0.data", 10));  // 3 верхних уровня дерева (7 блоков) при любом subtreeHeight
+    tiers.push_back(StorageTier("storage_tier1.data"));
+
+    for (int64_t subtreeHeight = 1; subtreeHeight <= 2; ++subtreeHeight)
+    {
+        {
+            ExternalStorage<int64_t> storage(tiers, 2, true, subtreeHeight);
+
+            for (int64_t i = 0; i < 21; ++i)
+            {
+                std::vector<int64_t> b(2, i);
+                storage.writeBlock(i, b);
+            }
+            for (int64_t i = 0; i < 21; ++i)
+                EXPECT_EQ(storage.readBlock(i), std::vector<int64_t>(2, i));
+        }
+
+        // Файлы используют общую нумерацию блоков, поэтому размер файла - последний физический номер + 1
+        // (заголовок - 4096 байт). При subtreeHeight == 2 блоки 3-го уровня лежат в 4 разных поддеревьях
+        int64_t tier0Blocks = (subtreeHeight == 1) ? 7 : 13;
+        int64_t tier1Blocks = (subtreeHeight == 1) ? 21 : 31;
+        EXPECT_EQ(fileSize("storage_tier0.data"), 4096 + tier0Blocks * 2 * sizeof(int64_t));
+        EXPECT_EQ(fileSize("storage_tier1.data"), 4096 + tier1Blocks * 2 * sizeof(int64_t));
+
+        {
+            ExternalStorage<int64_t> storage(tiers, 2, false, subtreeHeight);
+
+            for (int64_t i = 0; i < 21; ++i)
+                EXPECT_EQ(storage.readBlock(i), std::vector<int64_t>(2, i));
+        }
+    }
+}
+
+TEST(ExternalStorageTesting, WriteAndReadBlocksWithMovingTierBound)
+{
+    std::vector<StorageTier> tiers;
+    tiers.push_back(StorageTier("storage_tier0.data", 0, 2));  // Все уровни дерева, кроме двух нижних
+    tiers.push_back(StorageTier("storage_tier1.data"));
+
+    {
+        ExternalStorage<int64_t> storage(tiers, 2, true);
+
+        for (int64_t i = 0; i < 255; ++i)
+        {
+            std::vector<int64_t> b(2, i);
+            storage.writeBlock(i, b);
+        }
+        for (int64_t i = 0; i < 255; ++i)
+            EXPECT_EQ(storage.readBlock(i), std::vector<int64_t>(2, i));
+
+        // 8 уровней дерева: 6 верхних уже перенесены в первый файл
+        EXPECT_EQ(fileSize("storage_tier0.data"), 4096 + 63 * 2 * sizeof(int64_t));
+
+        // Дерево выросло ещё на уровень, перенос 6-го уровня только начат
+        std::vector<int64_t> b(2, 255);
+        storage.writeBlock(255, b);
+    }
+    {
+        ExternalStorage<int64_t> storage(tiers, 2);
+
+        for (int64_t i = 0; i < 256; ++i)
+            EXPECT_EQ(storage.readBlock(i), std::vector<int64_t>(2, i));
+        for (int64_t i = 100; i < 300; ++i)
+        {
+            std::vector<int64_t> b(2, -i);
+            storage.writeBlock(i, b);
+        }
+        for (int64_t i = 0; i < 300; ++i)
+            EXPECT_EQ(storage.readBlock(i), std::vector<int64_t>(2, (i < 100) ? i : -i));
+    }
+    EXPECT_EQ(fileSize("storage_tier0.data"), 4096 + 127 * 2 * sizeof(int64_t));
+}
+
+TEST(ExternalStorageTesting, BadConfig)
+{
+    EXPECT_THROW(ExternalStorage<int64_t>(std::vector<StorageTier>(), 2, true), BadStorageConfigException);
+    EXPECT_THROW(ExternalStorage<int64_t>("storage.data", 2, true, 0), BadStorageConfigException);
+    EXPECT_THROW(ExternalStorage<int64_t>("storage.data", 2, true, 63), BadStorageConfigException);
+    EXPECT_THROW(ExternalStorage<int64_t>("storage.data", 0, true), BadStorageConfigException);
+    EXPECT_THROW(ExternalStorage<std::string>("storage.data", 2, true), BadStorageConfigException);  // Размер слота не задан
+
+    std::vector<StorageTier> tiers;
+    tiers.push_back(StorageTier("storage_tier0.data", 10));
+    tiers.push_back(StorageTier("storage_tier1.data"));
+    {
+        ExternalStorage<int64_t> storage(tiers, 2, true, 2);
+        std::vector<int64_t> b(2, 1);
+        storage.writeBlock(20, b);
+    }
+
+    // Файлы созданы с другими параметрами
+    EXPECT_THROW(ExternalStorage<int64_t>(tiers, 4, false, 2), StorageConfigMismatchException);
+    EXPECT_THROW(ExternalStorage<int64_t>(tiers, 2, false, 1), StorageConfigMismatchException);
+    EXPECT_THROW(ExternalStorage<int32_t>(tiers, 2, false, 2), StorageConfigMismatchException);
+    EXPECT_THROW(ExternalStorage<int64_t>("storage_tier1.data", 2, false, 2), StorageConfigMismatchException);
+
+    std::vector<StorageTier> otherTiers(tiers);
+    otherTiers[0].maxBlocks = 100;
+    EXPECT_THROW(ExternalStorage<int64_t>(otherTiers, 2, false, 2), StorageConfigMismatchException);
+    std::swap(otherTiers[0], otherTiers[1]);
+    EXPECT_THROW(ExternalStorage<int64_t>(otherTiers, 2, false, 2), StorageConfigMismatchException);
+
+    ExternalStorage<int64_t> storage(tiers, 2, false, 2);
+    EXPECT_EQ(storage.readBlock(20), std::vector<int64_t>(2, 1));
+}
+
+TEST(ExternalStorageTesting, ForeignFileIsNotTruncated)
+{
+    for (int64_t size = 10; size <= 10000; size *= 1000)
+    {
+        FILE* f = fopen("storage.data", "w");
+        std::vector<char> data(size, 'x');
+        fwrite(data.data(), 1, size, f);
+        fclose(f);
+
+        EXPECT_THROW(ExternalStorage<int64_t>("storage.data", 2), StorageConfigMismatchException);
+        EXPECT_EQ(fileSize("storage.data"), size);
+    }
+
+    // Пустой файл - новое хранилище
+    fclose(fopen("storage.data", "w"));
+    ExternalStorage<int64_t> storage("storage.data", 2);
+    EXPECT_EQ(storage.readBlock(0).size(), 0);
+}
+
+TEST(ExternalStorageTesting, ReopenWithoutCleanClose)
+{
+    std::vector<StorageTier> tiers;
+    tiers.push_back(StorageTier("storage_tier0.data", 0, 2));
+    tiers.push_back(StorageTier("storage_tier1.data"));
+
+    std::vector<int64_t> expected;
+    for (int64_t i = 0; i < 266; ++i)
+        expected.push_back(i);
+
+    // Хранилище не закрывается (деструктор не вызывается), как при аварийном завершении процесса
+    ExternalStorage<int64_t>* storage = new ExternalStorage<int64_t>(tiers, 2, true);
+    for (int64_t i = 0; i < 266; ++i)
+    {
+        std::vector<int64_t> b(2, i);
+        storage->writeBlock(i, b);
+    }
+
+    // Перенос 6-го уровня (блоки 63-126) в первый файл начат, часть перенесённых блоков перезаписывается
+    for (int64_t i = 63; i < 68; ++i)
+    {
+        expected[i] = -i;
+        std::vector<int64_t> b(2, -i);
+        storage->writeBlock(i, b);
+    }
+    {
+        ExternalStorage<int64_t> reopened(tiers, 2);
+        for (int64_t i = 0; i < 266; ++i)
+            EXPECT_EQ(reopened.readBlock(i), std::vector<int64_t>(2, expected[i]));
+    }
+
+    // Перенос уровня закончен
+    for (int64_t i = 266; i < 400; ++i)
+    {
+        expected.push_back(i);
+        std::vector<int64_t> b(2, i);
+        storage->writeBlock(i, b);
+    }
+    for (int64_t i = 63; i < 127; ++i)
+    {
+        expected[i] = -i;
+        std::vector<int64_t> b(2, -i);
+        storage->writeBlock(i, b);
+    }
+    {
+        ExternalStorage<int64_t> reopened(tiers, 2);
+        for (int64_t i = 0; i < 400; ++i)
+            EXPECT_EQ(reopened.readBlock(i), std::vector<int64_t>(2, expected[i]));
+    }
+}
+
+TEST(ExternalStorageTesting, WriteAndReadStringBlocks)
+{
+    std::vector<std::vector<std::string> > blocks;
+    for (int64_t i = 0; i < 50; ++i)
+    {
+        std::vector<std::string> b;
+        for (int64_t j = 0; j < 3; ++j)
+            b.push_back(std::string(i * j, 'a' + j));  // Строки всё длиннее, поздние блоки не помещаются в слот
+        blocks.push_back(b);
+    }
+    {
+        ExternalStorage<std::string> storage("storage.data", 3, true, 1, 64);
+
+        for (int64_t i = 0; i < blocks.size(); ++i)
+        {
+            std::vector<std::string> b = blocks[i];
+            storage.writeBlock(i, b);
+        }
+        for (int64_t i = 0; i < blocks.size(); ++i)
+            EXPECT_EQ(storage.readBlock(i), blocks[i]);
+
+        // Неполный блок дополняется пустыми строками
+        std::vector<std::string> b(1, "x");
+        storage.writeBlock(10, b);
+        EXPECT_EQ(b.size(), 3);
+        b = storage.readBlock(10);
+        EXPECT_EQ(b[0], "x");
+        EXPECT_EQ(b[1], "");
+        blocks[10] = b;
+    }
+    {
+        ExternalStorage<std::string> storage("storage.data", 3, false, 1, 64);
+
+        for (int64_t i = 0; i < blocks.size(); ++i)
+            EXPECT_EQ(storage.readBlock(i), blocks[i]);
+        EXPECT_EQ(storage.readBlock(blocks.size()).size(), 0);
+    }
+
+    // Количество элементов в блоке не ограничено: блок читается таким, каким записан
+    {
+        ExternalStorage<std::string> storage("storage.data", 0, true, 1, 64);
+
+        for (int64_t i = 0; i < blocks.size(); ++i)
+        {
+            blocks[i].resize(i % 7);
+            std::vector<std::string> b = blocks[i];
+            storage.writeBlock(i, b);
+        }
+        for (int64_t i = 0; i < blocks.size(); ++i)
+            EXPECT_EQ(storage.readBlock(i), blocks[i]);
+    }
+}
+
+TEST(ExternalStorageTesting, WriteAndReadOversizedStringBlock)
+{
+    const int64_t blocks = 50;
+    std::vector<std::string> small(4, "abc");
+    std::vector<std::string> large(small);
+    large[1] = std::string(100000, 'z');
+    int64_t overflowSize = 0;
+    int64_t extentSize = 0;
+    {
+        ExternalStorage<std::string> storage("storage.data", 4, true, 1, 256);
+
+        for (int64_t i = 0; i < blocks; ++i)
+        {
+            std::vector<std::string> b(small);
+            storage.writeBlock(i, b);
+        }
+
+        // Большой блок пишется в слот и в свой участок файла переполнения, остальные блоки не трогаются
+        int64_t ioCount = storage.ioCount();
+        std::vector<std::string> b(large);
+        storage.writeBlock(10, b);
+        EXPECT_EQ(storage.ioCount(), ioCount + 2);
+        EXPECT_EQ(storage.readBlock(10), large);
+        EXPECT_EQ(storage.ioCount(), ioCount + 4);
+        EXPECT_EQ(fileSize("storage.data"), 4096 + blocks * 256);
+        overflowSize = fileSize("storage.data.overflow");
+        EXPECT_GT(overflowSize, 100000 - 256);  // В файле переполнения - только то, что не поместилось в слот
+        EXPECT_LE(overflowSize, 100000);
+        extentSize = (overflowSize + 255) / 256 * 256;  // Участок переполнения кратен размеру слота
+
+        // Блок снова помещается в слот - одна запись; его участок переполнения освобождается и достаётся блоку 12
+        b = small;
+        storage.writeBlock(10, b);
+        EXPECT_EQ(storage.ioCount(), ioCount + 5);
+        EXPECT_EQ(storage.readBlock(10), small);
+        b = large;
+        storage.writeBlock(12, b);
+        EXPECT_EQ(fileSize("storage.data.overflow"), overflowSize);
+        b = large;
+        storage.writeBlock(10, b);
+        EXPECT_EQ(fileSize("storage.data.overflow"), extentSize + overflowSize);
+        EXPECT_EQ(fileSize("storage.data"), 4096 + blocks * 256);
+    }
+
+    std::vector<std::string> larger(small);
+    larger[1] = std::string(200000, 'y');
+    {
+        // Участки переполнения восстанавливаются по слотам: блоки 10 и 12 пишутся на свои места
+        ExternalStorage<std::string> storage("storage.data", 4, false, 1, 256);
+
+        for (int64_t i = 0; i < blocks; ++i)
+            EXPECT_EQ(storage.readBlock(i), (i == 10 || i == 12) ? large : small);
+        std::vector<std::string> b(large);
+        storage.writeBlock(12, b);
+        b = large;
+        storage.writeBlock(10, b);
+        EXPECT_EQ(fileSize("storage.data.overflow"), extentSize + overflowSize);
+
+        // Блок 10 вырос и переехал в конец файла переполнения, его прежний участок свободен
+        b = larger;
+        storage.writeBlock(10, b);
+        EXPECT_GT(fileSize("storage.data.overflow"), 2 * extentSize + 200000 - 256);
+    }
+    int64_t fullSize = fileSize("storage.data.overflow");
+    {
+        // Свободный участок (промежуток между занятыми) тоже восстанавливается и переиспользуется
+        ExternalStorage<std::string> storage("storage.data", 4, false, 1, 256);
+
+        std::vector<std::string> b(large);
+        storage.writeBlock(14, b);
+        EXPECT_EQ(fileSize("storage.data.overflow"), fullSize);
+        for (int64_t i = 0; i < blocks; ++i)
+            EXPECT_EQ(storage.readBlock(i), (i == 12 || i == 14) ? large : ((i == 10) ? larger : small));
+    }
+
+    EXPECT_THROW(ExternalStorage<std::string>("storage.data", 4, false, 1, 512), StorageConfigMismatchException);
+    EXPECT_THROW(ExternalStorage<std::string>("storage.data", 4, true, 1, 16), BadStorageConfigException);
+}
+
 int main(int argc, char* argv[])
 {
     ::testing::InitGoogleTest(&argc, argv);